@@ -85,6 +85,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
 #ifdef WIN64
 #include <windows.h>
 #else
@@ -94,6 +99,9 @@
 // define bitboard data type
 #define U64 unsigned long long
 
+// define move data type
+#define U16 unsigned short
+
 // FEN dedug positions
 #define empty_board "8/8/8/8/8/8/8/8 b - - "
 #define start_position "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 "
@@ -186,7 +194,8 @@ enum
     b,
     r,
     q,
-    k
+    k,
+    no_piece
 };
 
 // sides to move (colors)
@@ -434,32 +443,68 @@ char promoted_pieces[] = {
 
 */
 
-// piece bitboards
-U64 bitboards[12];
+/*
+    Board state lives in a position structure that is passed explicitly
+    to every routine, so several positions (searches, perfts, threads)
+    can coexist in one process. The data touched on every move comes
+    first and is aligned to a cache line boundary.
+*/
+
+// move undo record
+typedef struct
+{
+    // piece captured by the move (no_piece on quiet moves)
+    int captured_piece;
+
+    // castling rights before the move
+    int castle;
+
+    // enpassant square before the move
+    int enpassant;
+
+    // hash key before the move
+    U64 hash_key;
+} undo;
+
+// chess position
+typedef struct
+{
+    // piece bitboards
+    _Alignas(64) U64 bitboards[12];
+
+    // occupancy bitboards
+    U64 occupancies[3];
+
+    // "almost" unique position identifier aka hash key or position key
+    U64 hash_key;
+
+    // piece on every board square (no_piece on empty squares)
+    unsigned char piece_on[64];
 
-// occupancy bitboards
-U64 occupancies[3];
+    // side to move
+    int side;
 
-// side to move
-int side;
+    // enpassant square
+    int enpassant;
 
-// enpassant square
-int enpassant = no_sq;
+    // castling rights
+    int castle;
 
-// castling rights
-int castle;
+    // half move counter
+    int ply;
 
-// "almost" unique position identifier aka hash key or position key
-U64 hash_key;
+    // repetition index
+    int repetition_index;
 
-// positions repetition table
-U64 repetition_table[1000]; // 1000 is a number of plies (500 moves) in the entire game
+    // positions repetition table
+    U64 repetition_table[1000]; // 1000 is a number of plies (500 moves) in the entire game
 
-// repetition index
-int repetition_index;
+    // undo stack index
+    int undo_index;
 
-// half move counter
-int ply;
+    // undo records of the moves made on board
+    undo undo_stack[1000];
+} position;
 
 /**********************************\
  ==================================
@@ -479,7 +524,7 @@ int movestogo = 30;
 int movetime = -1;
 
 // UCI "time" command holder (ms)
-int time = -1;
+int uci_time = -1;
 
 // UCI "inc" command's time increment holder
 int inc = 0;
@@ -493,8 +538,8 @@ int stoptime = 0;
 // variable to flag time control availability
 int timeset = 0;
 
-// variable to flag when the time is up
-int stopped = 0;
+// variable to flag when the time is up (read by all search threads)
+atomic_int stopped = 0;
 
 /**********************************\
  ==================================
@@ -586,9 +631,6 @@ void read_input()
     // "listen" to STDIN
     if (input_waiting())
     {
-        // tell engine to stop calculating
-        stopped = 1;
-
         // loop to read bytes from STDIN
         do
         {
@@ -614,14 +656,21 @@ void read_input()
             {
                 // tell engine to terminate exacution
                 quit = 1;
+
+                // tell engine to stop calculating
+                stopped = 1;
             }
 
-            // // match UCI "stop" command
+            // match UCI "stop" command
             else if (!strncmp(input, "stop", 4))
             {
-                // tell engine to terminate exacution
-                quit = 1;
+                // tell engine to stop calculating
+                stopped = 1;
             }
+
+            // match UCI "isready" command (GUI is waiting for the reply while we search)
+            else if (!strncmp(input, "isready", 7))
+                printf("readyok\n");
         }
     }
 }
@@ -691,6 +740,28 @@ U64 generate_magic_number()
     return get_random_U64_number() & get_random_U64_number() & get_random_U64_number();
 }
 
+/*
+    Hash keys need their own generator: numbers sliced from the 32-bit
+    XOR shift state above are linear functions of a 32-bit seed, so any
+    33 of them are linearly dependent and different positions collide
+    way too often once the tree grows into billions of nodes.
+*/
+
+// pseudo random 64-bit number state (hash keys)
+U64 random_key_state = 1070372ULL;
+
+// generate 64-bit pseudo random hash keys (XOR shift * algorithm)
+U64 get_random_key()
+{
+    // XOR shift algorithm
+    random_key_state ^= random_key_state >> 12;
+    random_key_state ^= random_key_state << 25;
+    random_key_state ^= random_key_state >> 27;
+
+    // scramble the state non-linearly
+    return random_key_state * 2685821657736338717ULL;
+}
+
 /**********************************\
  ==================================
 
@@ -704,13 +775,26 @@ U64 generate_magic_number()
 #define get_bit(bitboard, square) ((bitboard) & (1ULL << (square)))
 #define pop_bit(bitboard, square) ((bitboard) &= ~(1ULL << (square)))
 
-// count bits within a bitboard (Brian Kernighan's way)
+/*
+    Bit counting & bit scanning backends are picked at compile time:
+    builds targeting POPCNT (-mpopcnt) and BMI (-mbmi) use the single
+    POPCNT & TZCNT instructions, other GCC/Clang builds scan bits with
+    the compiler builtin (BSF) and count them in portable code. Builds
+    with -DPORTABLE_BITOPS use portable code for both (make portable).
+    Hardware builds check the host CPU at startup (see check_cpu_features).
+*/
+
+// count bits within a bitboard
 static inline int count_bits(U64 bitboard)
 {
+#if defined(__POPCNT__) && !defined(PORTABLE_BITOPS)
+    // hardware population count
+    return __builtin_popcountll(bitboard);
+#else
     // bit counter
     int count = 0;
 
-    // consecutively reset least significant 1st bit
+    // consecutively reset least significant 1st bit (Brian Kernighan's way)
     while (bitboard)
     {
         // increment count
@@ -722,6 +806,7 @@ static inline int count_bits(U64 bitboard)
 
     // return bit count
     return count;
+#endif
 }
 
 // get least significant 1st bit index
@@ -730,8 +815,13 @@ static inline int get_ls1b_index(U64 bitboard)
     // make sure bitboard is not 0
     if (bitboard)
     {
+#if (defined(__BMI__) || defined(__GNUC__)) && !defined(PORTABLE_BITOPS)
+        // count trailing zeros (TZCNT with BMI, BSF otherwise)
+        return __builtin_ctzll(bitboard);
+#else
         // count trailing bits before LS1B
         return count_bits((bitboard & -bitboard) - 1);
+#endif
     }
 
     // otherwise
@@ -740,6 +830,42 @@ static inline int get_ls1b_index(U64 bitboard)
         return -1;
 }
 
+// make sure host CPU supports instructions the binary was built for
+void check_cpu_features()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    // init CPU feature detection
+    __builtin_cpu_init();
+
+#ifdef __POPCNT__
+    // POPCNT instruction is missing
+    if (!__builtin_cpu_supports("popcnt"))
+    {
+        printf("  This build requires a CPU with POPCNT, use the portable build instead!\n");
+        exit(1);
+    }
+#endif
+
+#ifdef __BMI2__
+    // PEXT instruction is missing
+    if (!__builtin_cpu_supports("bmi2"))
+    {
+        printf("  This build requires a CPU with BMI2, use the portable build instead!\n");
+        exit(1);
+    }
+#endif
+
+#ifdef __BMI__
+    // TZCNT instruction is missing
+    if (!__builtin_cpu_supports("bmi"))
+    {
+        printf("  This build requires a CPU with BMI, use the portable build instead!\n");
+        exit(1);
+    }
+#endif
+#endif
+}
+
 /**********************************\
  ==================================
 
@@ -763,8 +889,8 @@ U64 side_key;
 // init random hash keys
 void init_random_keys()
 {
-    // update pseudo random number state
-    random_state = 1804289383;
+    // update pseudo random key state
+    random_key_state = 1070372ULL;
 
     // loop over piece codes
     for (int piece = P; piece <= k; piece++)
@@ -772,25 +898,25 @@ void init_random_keys()
         // loop over board squares
         for (int square = 0; square < 64; square++)
             // init random piece keys
-            piece_keys[piece][square] = get_random_U64_number();
+            piece_keys[piece][square] = get_random_key();
     }
 
     // loop over board squares
     for (int square = 0; square < 64; square++)
         // init random enpassant keys
-        enpassant_keys[square] = get_random_U64_number();
+        enpassant_keys[square] = get_random_key();
 
     // loop over castling keys
     for (int index = 0; index < 16; index++)
         // init castling keys
-        castle_keys[index] = get_random_U64_number();
+        castle_keys[index] = get_random_key();
 
     // init random side key
-    side_key = get_random_U64_number();
+    side_key = get_random_key();
 }
 
 // generate "almost" unique position ID aka hash key from scratch
-U64 generate_hash_key()
+U64 generate_hash_key(position *pos)
 {
     // final hash key
     U64 final_key = 0ULL;
@@ -802,7 +928,7 @@ U64 generate_hash_key()
     for (int piece = P; piece <= k; piece++)
     {
         // init piece bitboard copy
-        bitboard = bitboards[piece];
+        bitboard = pos->bitboards[piece];
 
         // loop over the pieces within a bitboard
         while (bitboard)
@@ -819,15 +945,15 @@ U64 generate_hash_key()
     }
 
     // if enpassant square is on board
-    if (enpassant != no_sq)
+    if (pos->enpassant != no_sq)
         // hash enpassant
-        final_key ^= enpassant_keys[enpassant];
+        final_key ^= enpassant_keys[pos->enpassant];
 
     // hash castling rights
-    final_key ^= castle_keys[castle];
+    final_key ^= castle_keys[pos->castle];
 
     // hash the side only if black is to move
-    if (side == black)
+    if (pos->side == black)
         final_key ^= side_key;
 
     // return generated hash key
@@ -877,7 +1003,7 @@ void print_bitboard(U64 bitboard)
 }
 
 // print board
-void print_board()
+void print_board(position *pos)
 {
     // print offset
     printf("\n");
@@ -895,23 +1021,14 @@ void print_board()
             if (!file)
                 printf("  %d ", 8 - rank);
 
-            // define piece variable
-            int piece = -1;
-
-            // loop over all piece bitboards
-            for (int bb_piece = P; bb_piece <= k; bb_piece++)
-            {
-                // if there is a piece on current square
-                if (get_bit(bitboards[bb_piece], square))
-                    // get piece code
-                    piece = bb_piece;
-            }
+            // init piece on current square
+            int piece = pos->piece_on[square];
 
 // print different piece set depending on OS
 #ifdef WIN64
-            printf(" %c", (piece == -1) ? '.' : ascii_pieces[piece]);
+            printf(" %c", (piece == no_piece) ? '.' : ascii_pieces[piece]);
 #else
-            printf(" %s", (piece == -1) ? "." : unicode_pieces[piece]);
+            printf(" %s", (piece == no_piece) ? "." : unicode_pieces[piece]);
 #endif
         }
 
@@ -923,40 +1040,47 @@ void print_board()
     printf("\n     a b c d e f g h\n\n");
 
     // print side to move
-    printf("     Side:     %s\n", !side ? "white" : "black");
+    printf("     Side:     %s\n", !pos->side ? "white" : "black");
 
     // print enpassant square
-    printf("     Enpassant:   %s\n", (enpassant != no_sq) ? square_to_coordinates[enpassant] : "no");
+    printf("     Enpassant:   %s\n", (pos->enpassant != no_sq) ? square_to_coordinates[pos->enpassant] : "no");
 
     // print castling rights
-    printf("     Castling:  %c%c%c%c\n\n", (castle & wk) ? 'K' : '-',
-           (castle & wq) ? 'Q' : '-',
-           (castle & bk) ? 'k' : '-',
-           (castle & bq) ? 'q' : '-');
+    printf("     Castling:  %c%c%c%c\n\n", (pos->castle & wk) ? 'K' : '-',
+           (pos->castle & wq) ? 'Q' : '-',
+           (pos->castle & bk) ? 'k' : '-',
+           (pos->castle & bq) ? 'q' : '-');
 
     // print hash key
-    printf("     Hash key:  %llx\n\n", hash_key);
+    printf("     Hash key:  %llx\n\n", pos->hash_key);
 }
 
 // parse FEN string
-void parse_fen(char *fen)
+void parse_fen(position *pos, char *fen)
 {
     // reset board position (bitboards)
-    memset(bitboards, 0ULL, sizeof(bitboards));
+    memset(pos->bitboards, 0ULL, sizeof(pos->bitboards));
 
     // reset occupancies (bitboards)
-    memset(occupancies, 0ULL, sizeof(occupancies));
+    memset(pos->occupancies, 0ULL, sizeof(pos->occupancies));
+
+    // reset pieces on squares
+    memset(pos->piece_on, no_piece, sizeof(pos->piece_on));
 
     // reset game state variables
-    side = 0;
-    enpassant = no_sq;
-    castle = 0;
+    pos->side = 0;
+    pos->enpassant = no_sq;
+    pos->castle = 0;
+    pos->ply = 0;
+
+    // reset undo stack
+    pos->undo_index = 0;
 
     // reset repetition index
-    repetition_index = 0;
+    pos->repetition_index = 0;
 
     // reset repetition table
-    memset(repetition_table, 0ULL, sizeof(repetition_table));
+    memset(pos->repetition_table, 0ULL, sizeof(pos->repetition_table));
 
     // loop over board ranks
     for (int rank = 0; rank < 8; rank++)
@@ -974,7 +1098,10 @@ void parse_fen(char *fen)
                 int piece = char_pieces[*fen];
 
                 // set piece on corresponding bitboard
-                set_bit(bitboards[piece], square);
+                set_bit(pos->bitboards[piece], square);
+
+                // set piece on square
+                pos->piece_on[square] = piece;
 
                 // increment pointer to FEN string
                 fen++;
@@ -986,20 +1113,8 @@ void parse_fen(char *fen)
                 // init offset (convert char 0 to int 0)
                 int offset = *fen - '0';
 
-                // define piece variable
-                int piece = -1;
-
-                // loop over all piece bitboards
-                for (int bb_piece = P; bb_piece <= k; bb_piece++)
-                {
-                    // if there is a piece on current square
-                    if (get_bit(bitboards[bb_piece], square))
-                        // get piece code
-                        piece = bb_piece;
-                }
-
                 // on empty current square
-                if (piece == -1)
+                if (pos->piece_on[square] == no_piece)
                     // decrement file
                     file--;
 
@@ -1021,7 +1136,7 @@ void parse_fen(char *fen)
     fen++;
 
     // parse side to move
-    (*fen == 'w') ? (side = white) : (side = black);
+    (*fen == 'w') ? (pos->side = white) : (pos->side = black);
 
     // go to parsing castling rights
     fen += 2;
@@ -1032,16 +1147,16 @@ void parse_fen(char *fen)
         switch (*fen)
         {
         case 'K':
-            castle |= wk;
+            pos->castle |= wk;
             break;
         case 'Q':
-            castle |= wq;
+            pos->castle |= wq;
             break;
         case 'k':
-            castle |= bk;
+            pos->castle |= bk;
             break;
         case 'q':
-            castle |= bq;
+            pos->castle |= bq;
             break;
         case '-':
             break;
@@ -1062,29 +1177,29 @@ void parse_fen(char *fen)
         int rank = 8 - (fen[1] - '0');
 
         // init enpassant square
-        enpassant = rank * 8 + file;
+        pos->enpassant = rank * 8 + file;
     }
 
     // no enpassant square
     else
-        enpassant = no_sq;
+        pos->enpassant = no_sq;
 
     // loop over white pieces bitboards
     for (int piece = P; piece <= K; piece++)
         // populate white occupancy bitboard
-        occupancies[white] |= bitboards[piece];
+        pos->occupancies[white] |= pos->bitboards[piece];
 
     // loop over black pieces bitboards
     for (int piece = p; piece <= k; piece++)
         // populate white occupancy bitboard
-        occupancies[black] |= bitboards[piece];
+        pos->occupancies[black] |= pos->bitboards[piece];
 
     // init all occupancies
-    occupancies[both] |= occupancies[white];
-    occupancies[both] |= occupancies[black];
+    pos->occupancies[both] |= pos->occupancies[white];
+    pos->occupancies[both] |= pos->occupancies[black];
 
     // init hash key
-    hash_key = generate_hash_key();
+    pos->hash_key = generate_hash_key(pos);
 }
 
 /**********************************\
@@ -1146,6 +1261,13 @@ const int rook_relevant_bits[64] = {
     11, 10, 10, 10, 10, 10, 10, 11,
     12, 11, 11, 11, 11, 11, 11, 12};
 
+#ifdef SEARCHED_MAGICS
+
+// shift-reduced magics found by magic_search tool (see makefile)
+#include "magics.h"
+
+#else
+
 // rook magic numbers
 U64 rook_magic_numbers[64] = {
     0x8a80104000800020ULL,
@@ -1280,6 +1402,70 @@ U64 bishop_magic_numbers[64] = {
     0x8918844842082200ULL,
     0x4010011029020020ULL};
 
+#endif
+
+/*
+    Slider attacks backend is picked at compile time:
+
+      default           magic bitboards (multiply & shift index)
+      -DUSE_PEXT        BMI2 PEXT instruction extracts the index (-mbmi2)
+      -DUSE_HYPERBOLA   hyperbola quintessence, no attack tables at all
+
+    Magic & PEXT backends index the same compact shared attacks table.
+
+    Run the binary with -benchsliders to compare backends on a host.
+*/
+
+#if defined(USE_PEXT) && defined(USE_HYPERBOLA)
+#error "USE_PEXT and USE_HYPERBOLA are mutually exclusive"
+#endif
+
+#if defined(USE_PEXT) && !defined(__BMI2__)
+#error "USE_PEXT requires a BMI2 target (-mbmi2)"
+#endif
+
+#if defined(SEARCHED_MAGICS) && (defined(USE_PEXT) || defined(USE_HYPERBOLA))
+#error "SEARCHED_MAGICS only applies to magic bitboards backend"
+#endif
+
+/*
+    Attack tables are either built by init_all at startup or, in builds
+    with -DBAKED_TABLES, compiled in from bbc2_tables.h generated by
+    running a regular build with -printtables (see makefile).
+*/
+
+/*
+    Bishop & rook attacks share a single table: every square only takes
+    2^(relevant bits) entries starting at its own offset, bishop attacks
+    first, rook attacks right after them (fancy magic bitboards).
+*/
+
+// searched magics come with their own table sizes
+#ifndef SEARCHED_MAGICS
+// number of bishop attacks entries (sum of 2^bishop_relevant_bits)
+#define bishop_table_size 5248
+
+// number of bishop & rook attacks entries (sum of 2^rook_relevant_bits added)
+#define slider_table_size 107648
+#endif
+
+#ifdef BAKED_TABLES
+
+// attack tables generated at build time
+#include "bbc2_tables.h"
+
+// make sure baked tables match the compiled sliders backend
+#if defined(USE_PEXT) != baked_pext || defined(USE_HYPERBOLA) != baked_hyperbola
+#error "bbc2_tables.h was generated for another sliders backend"
+#endif
+
+// make sure baked slider attacks are indexed by the compiled magic numbers
+#if !defined(baked_searched_magics) || defined(SEARCHED_MAGICS) != baked_searched_magics
+#error "bbc2_tables.h was generated with another SEARCHED_MAGICS setting"
+#endif
+
+#else
+
 // pawn attacks table [side][square]
 U64 pawn_attacks[2][64];
 
@@ -1295,11 +1481,32 @@ U64 bishop_masks[64];
 // rook attack masks
 U64 rook_masks[64];
 
-// bishop attacks table [square][occupancies]
-U64 bishop_attacks[64][512];
+#ifdef USE_HYPERBOLA
+// diagonal masks [square] (square itself excluded)
+U64 diagonal_masks[64];
+
+// anti-diagonal masks [square] (square itself excluded)
+U64 anti_diagonal_masks[64];
+
+// file masks [square] (square itself excluded)
+U64 file_masks[64];
+
+// rank attacks [file][inner 6 bits of rank occupancy]
+unsigned char first_rank_attacks[8][64];
+#else
+// bishop & rook attacks table [offset + occupancy index]
+U64 slider_attacks[slider_table_size];
+
+// offsets of square's attacks within slider attacks table [square]
+int bishop_offsets[64];
+int rook_offsets[64];
+
+// magic index shifts (64 - relevant bits) [square]
+int bishop_shifts[64];
+int rook_shifts[64];
+#endif
 
-// rook attacks rable [square][occupancies]
-U64 rook_attacks[64][4096];
+#endif
 
 // generate pawn attacks
 U64 mask_pawn_attacks(int side, int square)
@@ -1688,9 +1895,61 @@ void init_magic_numbers()
         bishop_magic_numbers[square] = find_magic_number(square, bishop_relevant_bits[square], bishop);
 }
 
+#ifdef USE_HYPERBOLA
+// init line masks & rank attacks for hyperbola quintessence
+void init_hyperbola_masks()
+{
+    // loop over 64 board squares
+    for (int square = 0; square < 64; square++)
+    {
+        // init rank & file of the square
+        int rank = square / 8;
+        int file = square % 8;
+
+        // reset line masks
+        diagonal_masks[square] = anti_diagonal_masks[square] = file_masks[square] = 0ULL;
+
+        // loop over target squares
+        for (int target_square = 0; target_square < 64; target_square++)
+        {
+            // init rank & file of the target square
+            int target_rank = target_square / 8;
+            int target_file = target_square % 8;
+
+            // square itself doesn't belong to its lines
+            if (target_square == square)
+                continue;
+
+            // same diagonal
+            if (target_rank - target_file == rank - file)
+                set_bit(diagonal_masks[square], target_square);
+
+            // same anti-diagonal
+            if (target_rank + target_file == rank + file)
+                set_bit(anti_diagonal_masks[square], target_square);
+
+            // same file
+            if (target_file == file)
+                set_bit(file_masks[square], target_square);
+        }
+    }
+
+    // loop over files
+    for (int file = 0; file < 8; file++)
+    {
+        // loop over inner rank occupancies (edge squares never block)
+        for (int occupancy = 0; occupancy < 64; occupancy++)
+            // init rank attacks along the first board rank
+            first_rank_attacks[file][occupancy] = rook_attacks_on_the_fly(file, (U64)occupancy << 1) & 0xFF;
+    }
+}
+#else
 // init slider piece's attack tables
 void init_sliders_attacks(int bishop)
 {
+    // init offset of the first square's attacks (rook attacks follow bishop attacks)
+    int offset = bishop ? 0 : bishop_table_size;
+
     // loop over 64 board squares
     for (int square = 0; square < 64; square++)
     {
@@ -1707,6 +1966,31 @@ void init_sliders_attacks(int bishop)
         // init occupancy indicies
         int occupancy_indicies = (1 << relevant_bits_count);
 
+#ifdef SEARCHED_MAGICS
+        // searched magics may index fewer bits than relevant occupancy bits
+        int index_bits = bishop ? bishop_index_bits[square] : rook_index_bits[square];
+
+        // searched magics come with their own table layout
+        offset = bishop ? bishop_table_offsets[square] : rook_table_offsets[square];
+#else
+        // init magic index bits
+        int index_bits = relevant_bits_count;
+#endif
+
+        // bishop offset & shift
+        if (bishop)
+        {
+            bishop_offsets[square] = offset;
+            bishop_shifts[square] = 64 - index_bits;
+        }
+
+        // rook offset & shift
+        else
+        {
+            rook_offsets[square] = offset;
+            rook_shifts[square] = 64 - index_bits;
+        }
+
         // loop over occupancy indicies
         for (int index = 0; index < occupancy_indicies; index++)
         {
@@ -1716,11 +2000,16 @@ void init_sliders_attacks(int bishop)
                 // init current occupancy variation
                 U64 occupancy = set_occupancy(index, relevant_bits_count, attack_mask);
 
+#ifdef USE_PEXT
+                // init occupancy index (occupancy bits packed along the mask)
+                int magic_index = index;
+#else
                 // init magic index
-                int magic_index = (occupancy * bishop_magic_numbers[square]) >> (64 - bishop_relevant_bits[square]);
+                int magic_index = (occupancy * bishop_magic_numbers[square]) >> bishop_shifts[square];
+#endif
 
                 // init bishop attacks
-                bishop_attacks[square][magic_index] = bishop_attacks_on_the_fly(square, occupancy);
+                slider_attacks[offset + magic_index] = bishop_attacks_on_the_fly(square, occupancy);
             }
 
             // rook
@@ -1729,15 +2018,79 @@ void init_sliders_attacks(int bishop)
                 // init current occupancy variation
                 U64 occupancy = set_occupancy(index, relevant_bits_count, attack_mask);
 
+#ifdef USE_PEXT
+                // init occupancy index (occupancy bits packed along the mask)
+                int magic_index = index;
+#else
                 // init magic index
-                int magic_index = (occupancy * rook_magic_numbers[square]) >> (64 - rook_relevant_bits[square]);
+                int magic_index = (occupancy * rook_magic_numbers[square]) >> rook_shifts[square];
+#endif
 
                 // init rook attacks
-                rook_attacks[square][magic_index] = rook_attacks_on_the_fly(square, occupancy);
+                slider_attacks[offset + magic_index] = rook_attacks_on_the_fly(square, occupancy);
             }
         }
+
+        // next square's attacks start right after current square's ones
+        offset += 1 << index_bits;
     }
 }
+#endif
+
+#if defined(USE_PEXT)
+
+// get bishop attacks
+static inline U64 get_bishop_attacks(int square, U64 occupancy)
+{
+    // extract relevant occupancy bits into attacks table index
+    return slider_attacks[bishop_offsets[square] + _pext_u64(occupancy, bishop_masks[square])];
+}
+
+// get rook attacks
+static inline U64 get_rook_attacks(int square, U64 occupancy)
+{
+    // extract relevant occupancy bits into attacks table index
+    return slider_attacks[rook_offsets[square] + _pext_u64(occupancy, rook_masks[square])];
+}
+
+#elif defined(USE_HYPERBOLA)
+
+// get slider attacks along a diagonal, anti-diagonal or file
+static inline U64 get_line_attacks(int square, U64 occupancy, U64 line_mask)
+{
+    // init blockers on the line & their vertically flipped copy
+    U64 forward = occupancy & line_mask;
+    U64 reverse = __builtin_bswap64(forward);
+
+    // subtract the slider to reach the nearest blocker in both directions
+    forward -= 1ULL << square;
+    reverse -= __builtin_bswap64(1ULL << square);
+
+    // merge both directions & keep the line squares only
+    forward ^= __builtin_bswap64(reverse);
+    return forward & line_mask;
+}
+
+// get bishop attacks
+static inline U64 get_bishop_attacks(int square, U64 occupancy)
+{
+    // combine diagonal & anti-diagonal attacks
+    return get_line_attacks(square, occupancy, diagonal_masks[square]) |
+           get_line_attacks(square, occupancy, anti_diagonal_masks[square]);
+}
+
+// get rook attacks
+static inline U64 get_rook_attacks(int square, U64 occupancy)
+{
+    // init first square of the rank
+    int rank_shift = square & 56;
+
+    // combine file attacks & rank attacks looked up by inner rank occupancy
+    return get_line_attacks(square, occupancy, file_masks[square]) |
+           ((U64)first_rank_attacks[square & 7][(occupancy >> (rank_shift + 1)) & 63] << rank_shift);
+}
+
+#else
 
 // get bishop attacks
 static inline U64 get_bishop_attacks(int square, U64 occupancy)
@@ -1745,10 +2098,10 @@ static inline U64 get_bishop_attacks(int square, U64 occupancy)
     // get bishop attacks assuming current board occupancy
     occupancy &= bishop_masks[square];
     occupancy *= bishop_magic_numbers[square];
-    occupancy >>= 64 - bishop_relevant_bits[square];
+    occupancy >>= bishop_shifts[square];
 
     // return bishop attacks
-    return bishop_attacks[square][occupancy];
+    return slider_attacks[bishop_offsets[square] + occupancy];
 }
 
 // get rook attacks
@@ -1757,42 +2110,80 @@ static inline U64 get_rook_attacks(int square, U64 occupancy)
     // get rook attacks assuming current board occupancy
     occupancy &= rook_masks[square];
     occupancy *= rook_magic_numbers[square];
-    occupancy >>= 64 - rook_relevant_bits[square];
+    occupancy >>= rook_shifts[square];
 
     // return rook attacks
-    return rook_attacks[square][occupancy];
+    return slider_attacks[rook_offsets[square] + occupancy];
 }
 
+#endif
+
 // get queen attacks
 static inline U64 get_queen_attacks(int square, U64 occupancy)
 {
-    // init result attacks bitboard
-    U64 queen_attacks = 0ULL;
+    // combine bishop & rook attacks
+    return get_bishop_attacks(square, occupancy) | get_rook_attacks(square, occupancy);
+}
 
-    // init bishop occupancies
-    U64 bishop_occupancy = occupancy;
+// slider attacks backend name
+#if defined(USE_PEXT)
+#define sliders_backend "pext"
+#elif defined(USE_HYPERBOLA)
+#define sliders_backend "hyperbola quintessence"
+#else
+#define sliders_backend "magic bitboards"
+#endif
 
-    // init rook occupancies
-    U64 rook_occupancy = occupancy;
+// number of random occupancies used by sliders benchmark
+#define bench_occupancies 4096
 
-    // get bishop attacks assuming current board occupancy
-    bishop_occupancy &= bishop_masks[square];
-    bishop_occupancy *= bishop_magic_numbers[square];
-    bishop_occupancy >>= 64 - bishop_relevant_bits[square];
+// time slider attacks lookups of the compiled backend
+void bench_sliders()
+{
+    // random occupancies
+    static U64 occupancies[bench_occupancies];
 
-    // get bishop attacks
-    queen_attacks = bishop_attacks[square][bishop_occupancy];
+    // init random occupancies (about a quarter of the board occupied)
+    for (int index = 0; index < bench_occupancies; index++)
+        occupancies[index] = get_random_key() & get_random_key();
 
-    // get rook attacks assuming current board occupancy
-    rook_occupancy &= rook_masks[square];
-    rook_occupancy *= rook_magic_numbers[square];
-    rook_occupancy >>= 64 - rook_relevant_bits[square];
+    // attacks checksum (keeps lookups from being optimized away)
+    U64 checksum = 0ULL;
+
+    // number of lookups done
+    U64 lookups = 0;
+
+    // init start time
+    int start = get_time_ms();
+
+    // repeat the whole pass to get a measurable time
+    for (int pass = 0; pass < 64; pass++)
+    {
+        // loop over random occupancies
+        for (int index = 0; index < bench_occupancies; index++)
+        {
+            // loop over 64 board squares
+            for (int square = 0; square < 64; square++)
+            {
+                // look up bishop & rook attacks
+                checksum += get_bishop_attacks(square, occupancies[index]);
+                checksum += get_rook_attacks(square, occupancies[index]);
+            }
+        }
+
+        // count lookups
+        lookups += bench_occupancies * 64 * 2;
+    }
 
-    // get rook attacks
-    queen_attacks |= rook_attacks[square][rook_occupancy];
+    // init elapsed time
+    int time = get_time_ms() - start;
 
-    // return queen attacks
-    return queen_attacks;
+    // print benchmark results
+    printf("\n     Sliders backend: %s\n", sliders_backend);
+    printf("     Lookups:         %llu\n", lookups);
+    printf("     Time:            %d ms\n", time);
+    printf("     Speed:           %.1f M lookups/s\n", time ? (double)lookups / time / 1000.0 : 0.0);
+    printf("     Checksum:        %llx\n\n", checksum);
 }
 
 /**********************************\
@@ -1803,35 +2194,47 @@ static inline U64 get_queen_attacks(int square, U64 occupancy)
  ==================================
 \**********************************/
 
+// get pieces of both sides attacking a square assuming the given board occupancy
+static inline U64 attackers_to(position *pos, int square, U64 occupancy)
+{
+    // init diagonal & orthogonal sliders of both sides
+    U64 diagonal = pos->bitboards[B] | pos->bitboards[Q] | pos->bitboards[b] | pos->bitboards[q];
+    U64 orthogonal = pos->bitboards[R] | pos->bitboards[Q] | pos->bitboards[r] | pos->bitboards[q];
+
+    // pawns, knights, kings & sliders looking at the square
+    return (pawn_attacks[black][square] & pos->bitboards[P]) |
+           (pawn_attacks[white][square] & pos->bitboards[p]) |
+           (knight_attacks[square] & (pos->bitboards[N] | pos->bitboards[n])) |
+           (king_attacks[square] & (pos->bitboards[K] | pos->bitboards[k])) |
+           (get_bishop_attacks(square, occupancy) & diagonal) |
+           (get_rook_attacks(square, occupancy) & orthogonal);
+}
+
 // is square current given attacked by the current given side
-static inline int is_square_attacked(int square, int side)
+static inline int is_square_attacked(position *pos, int square, int side)
 {
     // attacked by white pawns
-    if ((side == white) && (pawn_attacks[black][square] & bitboards[P]))
+    if ((side == white) && (pawn_attacks[black][square] & pos->bitboards[P]))
         return 1;
 
     // attacked by black pawns
-    if ((side == black) && (pawn_attacks[white][square] & bitboards[p]))
+    if ((side == black) && (pawn_attacks[white][square] & pos->bitboards[p]))
         return 1;
 
     // attacked by knights
-    if (knight_attacks[square] & ((side == white) ? bitboards[N] : bitboards[n]))
+    if (knight_attacks[square] & ((side == white) ? pos->bitboards[N] : pos->bitboards[n]))
         return 1;
 
-    // attacked by bishops
-    if (get_bishop_attacks(square, occupancies[both]) & ((side == white) ? bitboards[B] : bitboards[b]))
+    // attacked by bishops or queens
+    if (get_bishop_attacks(square, pos->occupancies[both]) & ((side == white) ? (pos->bitboards[B] | pos->bitboards[Q]) : (pos->bitboards[b] | pos->bitboards[q])))
         return 1;
 
-    // attacked by rooks
-    if (get_rook_attacks(square, occupancies[both]) & ((side == white) ? bitboards[R] : bitboards[r]))
-        return 1;
-
-    // attacked by bishops
-    if (get_queen_attacks(square, occupancies[both]) & ((side == white) ? bitboards[Q] : bitboards[q]))
+    // attacked by rooks or queens
+    if (get_rook_attacks(square, pos->occupancies[both]) & ((side == white) ? (pos->bitboards[R] | pos->bitboards[Q]) : (pos->bitboards[r] | pos->bitboards[q])))
         return 1;
 
     // attacked by kings
-    if (king_attacks[square] & ((side == white) ? bitboards[K] : bitboards[k]))
+    if (king_attacks[square] & ((side == white) ? pos->bitboards[K] : pos->bitboards[k]))
         return 1;
 
     // by default return false
@@ -1839,7 +2242,7 @@ static inline int is_square_attacked(int square, int side)
 }
 
 // print attacked squares
-void print_attacked_squares(int side)
+void print_attacked_squares(position *pos, int side)
 {
     printf("\n");
 
@@ -1857,7 +2260,7 @@ void print_attacked_squares(int side)
                 printf("  %d ", 8 - rank);
 
             // check whether current square is attacked or not
-            printf(" %d", is_square_attacked(square, side) ? 1 : 0);
+            printf(" %d", is_square_attacked(pos, square, side) ? 1 : 0);
         }
 
         // print new line every rank
@@ -1869,58 +2272,79 @@ void print_attacked_squares(int side)
 }
 
 /*
+    Moves are 16 bits wide: moving piece & captured piece are looked up
+    on the board (piece_on) whenever they're needed, so only squares and
+    move kind flags are stored.
+
           binary move bits                               hexidecimal constants
 
-    0000 0000 0000 0000 0011 1111    source square       0x3f
-    0000 0000 0000 1111 1100 0000    target square       0xfc0
-    0000 0000 1111 0000 0000 0000    piece               0xf000
-    0000 1111 0000 0000 0000 0000    promoted piece      0xf0000
-    0001 0000 0000 0000 0000 0000    capture flag        0x100000
-    0010 0000 0000 0000 0000 0000    double push flag    0x200000
-    0100 0000 0000 0000 0000 0000    enpassant flag      0x400000
-    1000 0000 0000 0000 0000 0000    castling flag       0x800000
+    0000 0000 0011 1111    source square                 0x3f
+    0000 1111 1100 0000    target square                 0xfc0
+    1111 0000 0000 0000    move flags                    0xf000
+
+             move flags
+
+    0000    quiet move
+    0001    double pawn push
+    0010    castling
+    0100    capture
+    0101    enpassant capture
+    10xx    promotion to knight (00), bishop (01), rook (10) or queen (11)
+    11xx    capture promotion to knight, bishop, rook or queen
 */
 
+// move flags
+enum
+{
+    quiet_flag,
+    double_push_flag,
+    castling_flag,
+    capture_flag = 4,
+    enpassant_flag = 5,
+    promotion_flag = 8
+};
+
 // encode move
-#define encode_move(source, target, piece, promoted, capture, double, enpassant, castling) \
-    (source) |                                                                             \
-        (target << 6) |                                                                    \
-        (piece << 12) |                                                                    \
-        (promoted << 16) |                                                                 \
-        (capture << 20) |                                                                  \
-        (double << 21) |                                                                   \
-        (enpassant << 22) |                                                                \
-        (castling << 23)
+#define encode_move(source, target, flags) ((source) | ((target) << 6) | ((flags) << 12))
+
+// encode promotion flags (promoted piece given by its white piece code N..Q)
+#define promotion_flags(promoted, capture) (promotion_flag | ((capture) ? capture_flag : 0) | ((promoted) - N))
 
 // extract source square
-#define get_move_source(move) (move & 0x3f)
+#define get_move_source(move) ((move) & 0x3f)
 
 // extract target square
-#define get_move_target(move) ((move & 0xfc0) >> 6)
+#define get_move_target(move) (((move) & 0xfc0) >> 6)
 
-// extract piece
-#define get_move_piece(move) ((move & 0xf000) >> 12)
+// extract move flags
+#define get_move_flags(move) (((move) & 0xf000) >> 12)
 
-// extract promoted piece
-#define get_move_promoted(move) ((move & 0xf0000) >> 16)
+// extract promotion flag
+#define get_move_promotion(move) ((move) & 0x8000)
+
+// extract promoted piece of a given side (0 if move isn't a promotion)
+#define get_move_promoted(move, side) (get_move_promotion(move) ? ((((move) >> 12) & 3) + N + (side) * 6) : 0)
 
 // extract capture flag
-#define get_move_capture(move) (move & 0x100000)
+#define get_move_capture(move) ((move) & 0x4000)
 
 // extract double pawn push flag
-#define get_move_double(move) (move & 0x200000)
+#define get_move_double(move) (get_move_flags(move) == double_push_flag)
 
 // extract enpassant flag
-#define get_move_enpassant(move) (move & 0x400000)
+#define get_move_enpassant(move) (get_move_flags(move) == enpassant_flag)
 
 // extract castling flag
-#define get_move_castling(move) (move & 0x800000)
+#define get_move_castling(move) (get_move_flags(move) == castling_flag)
 
-// move list structure
+// move list structure (moves & their ordering scores kept in separate arrays)
 typedef struct
 {
     // moves
-    int moves[256];
+    U16 moves[256];
+
+    // move ordering scores
+    int scores[256];
 
     // move count
     int count;
@@ -1939,17 +2363,17 @@ static inline void add_move(moves *move_list, int move)
 // print move (for UCI purposes)
 void print_move(int move)
 {
-    if (get_move_promoted(move))
+    if (get_move_promotion(move))
         printf("%s%s%c", square_to_coordinates[get_move_source(move)],
                square_to_coordinates[get_move_target(move)],
-               promoted_pieces[get_move_promoted(move)]);
+               promoted_pieces[get_move_promoted(move, white)]);
     else
         printf("%s%s", square_to_coordinates[get_move_source(move)],
                square_to_coordinates[get_move_target(move)]);
 }
 
 // print move list
-void print_move_list(moves *move_list)
+void print_move_list(position *pos, moves *move_list)
 {
     // do nothing on empty move list
     if (!move_list->count)
@@ -1970,8 +2394,8 @@ void print_move_list(moves *move_list)
         // print move
         printf("      %s%s%c   %c         %d         %d         %d         %d\n", square_to_coordinates[get_move_source(move)],
                square_to_coordinates[get_move_target(move)],
-               get_move_promoted(move) ? promoted_pieces[get_move_promoted(move)] : ' ',
-               ascii_pieces[get_move_piece(move)],
+               get_move_promotion(move) ? promoted_pieces[get_move_promoted(move, white)] : ' ',
+               ascii_pieces[pos->piece_on[get_move_source(move)]],
                get_move_capture(move) ? 1 : 0,
                get_move_double(move) ? 1 : 0,
                get_move_enpassant(move) ? 1 : 0,
@@ -1980,8 +2404,8 @@ void print_move_list(moves *move_list)
         // print move
         printf("     %s%s%c   %s         %d         %d         %d         %d\n", square_to_coordinates[get_move_source(move)],
                square_to_coordinates[get_move_target(move)],
-               get_move_promoted(move) ? promoted_pieces[get_move_promoted(move)] : ' ',
-               unicode_pieces[get_move_piece(move)],
+               get_move_promotion(move) ? promoted_pieces[get_move_promoted(move, white)] : ' ',
+               unicode_pieces[pos->piece_on[get_move_source(move)]],
                get_move_capture(move) ? 1 : 0,
                get_move_double(move) ? 1 : 0,
                get_move_enpassant(move) ? 1 : 0,
@@ -1994,26 +2418,32 @@ void print_move_list(moves *move_list)
 }
 
 // preserve board state
-#define copy_board()                                                    \
-    U64 bitboards_copy[12], occupancies_copy[3];                        \
-    int side_copy, enpassant_copy, castle_copy;                         \
-    memcpy(bitboards_copy, bitboards, 96);                              \
-    memcpy(occupancies_copy, occupancies, 24);                          \
-    side_copy = side, enpassant_copy = enpassant, castle_copy = castle; \
-    U64 hash_key_copy = hash_key;
+#define copy_board(pos)                                                                     \
+    U64 bitboards_copy[12], occupancies_copy[3];                                            \
+    unsigned char piece_on_copy[64];                                                        \
+    int side_copy, enpassant_copy, castle_copy, undo_index_copy;                            \
+    memcpy(bitboards_copy, (pos)->bitboards, 96);                                           \
+    memcpy(occupancies_copy, (pos)->occupancies, 24);                                       \
+    memcpy(piece_on_copy, (pos)->piece_on, 64);                                             \
+    side_copy = (pos)->side, enpassant_copy = (pos)->enpassant, castle_copy = (pos)->castle; \
+    undo_index_copy = (pos)->undo_index;                                                    \
+    U64 hash_key_copy = (pos)->hash_key;
 
 // restore board state
-#define take_back()                                                     \
-    memcpy(bitboards, bitboards_copy, 96);                              \
-    memcpy(occupancies, occupancies_copy, 24);                          \
-    side = side_copy, enpassant = enpassant_copy, castle = castle_copy; \
-    hash_key = hash_key_copy;
+#define take_back(pos)                                                                      \
+    memcpy((pos)->bitboards, bitboards_copy, 96);                                           \
+    memcpy((pos)->occupancies, occupancies_copy, 24);                                       \
+    memcpy((pos)->piece_on, piece_on_copy, 64);                                             \
+    (pos)->side = side_copy, (pos)->enpassant = enpassant_copy, (pos)->castle = castle_copy; \
+    (pos)->undo_index = undo_index_copy;                                                    \
+    (pos)->hash_key = hash_key_copy;
 
 // move types
 enum
 {
     all_moves,
-    only_captures
+    only_captures,
+    legal_moves
 };
 
 /*
@@ -2043,247 +2473,439 @@ const int castling_rights[64] = {
     15, 15, 15, 15, 15, 15, 15, 15,
     13, 15, 15, 15, 12, 15, 15, 14};
 
-// make move on chess board
-static inline int make_move(int move, int move_flag)
+#ifdef DEBUG
+// make sure incrementally updated occupancies & pieces on squares match piece bitboards
+void verify_board(position *pos)
 {
-    // quiet moves
-    if (move_flag == all_moves)
-    {
-        // preserve board state
-        copy_board();
-
-        // parse move
-        int source_square = get_move_source(move);
-        int target_square = get_move_target(move);
-        int piece = get_move_piece(move);
-        int promoted_piece = get_move_promoted(move);
-        int capture = get_move_capture(move);
-        int double_push = get_move_double(move);
-        int enpass = get_move_enpassant(move);
-        int castling = get_move_castling(move);
-
-        // move piece
-        pop_bit(bitboards[piece], source_square);
-        set_bit(bitboards[piece], target_square);
+    // rebuilt occupancies
+    U64 occupancies[3] = {0ULL, 0ULL, 0ULL};
 
-        // hash piece
-        hash_key ^= piece_keys[piece][source_square]; // remove piece from source square in hash key
-        hash_key ^= piece_keys[piece][target_square]; // set piece to the target square in hash key
+    // loop over white pieces bitboards
+    for (int bb_piece = P; bb_piece <= K; bb_piece++)
+        // update white occupancies
+        occupancies[white] |= pos->bitboards[bb_piece];
 
-        // handling capture moves
-        if (capture)
-        {
-            // pick up bitboard piece index ranges depending on side
-            int start_piece, end_piece;
+    // loop over black pieces bitboards
+    for (int bb_piece = p; bb_piece <= k; bb_piece++)
+        // update black occupancies
+        occupancies[black] |= pos->bitboards[bb_piece];
 
-            // white to move
-            if (side == white)
-            {
-                start_piece = p;
-                end_piece = k;
-            }
+    // update both sides occupancies
+    occupancies[both] = occupancies[white] | occupancies[black];
 
-            // black to move
-            else
-            {
-                start_piece = P;
-                end_piece = K;
-            }
+    // occupancies are out of sync
+    if (memcmp(occupancies, pos->occupancies, 24))
+    {
+        printf("  Occupancies don't match piece bitboards!\n");
+        print_board(pos);
+        exit(1);
+    }
 
-            // loop over bitboards opposite to the current side to move
-            for (int bb_piece = start_piece; bb_piece <= end_piece; bb_piece++)
-            {
-                // if there's a piece on the target square
-                if (get_bit(bitboards[bb_piece], target_square))
-                {
-                    // remove it from corresponding bitboard
-                    pop_bit(bitboards[bb_piece], target_square);
+    // loop over board squares
+    for (int square = 0; square < 64; square++)
+    {
+        // init piece on square according to bitboards
+        int piece = no_piece;
 
-                    // remove the piece from hash key
-                    hash_key ^= piece_keys[bb_piece][target_square];
-                    break;
-                }
-            }
+        // loop over all piece bitboards
+        for (int bb_piece = P; bb_piece <= k; bb_piece++)
+        {
+            // if there is a piece on current square
+            if (get_bit(pos->bitboards[bb_piece], square))
+                // get piece code
+                piece = bb_piece;
         }
 
-        // handle pawn promotions
-        if (promoted_piece)
+        // piece on square is out of sync
+        if (pos->piece_on[square] != piece)
         {
-            // white to move
-            if (side == white)
-            {
-                // erase the pawn from the target square
-                pop_bit(bitboards[P], target_square);
+            printf("  Piece on %s doesn't match piece bitboards!\n", square_to_coordinates[square]);
+            print_board(pos);
+            exit(1);
+        }
+    }
+}
+#endif
 
-                // remove pawn from hash key
-                hash_key ^= piece_keys[P][target_square];
-            }
+// take move back restoring board state from the undo stack
+static inline void unmake_move(position *pos, int move)
+{
+    // pop undo record
+    undo *state = &pos->undo_stack[--pos->undo_index];
 
-            // black to move
+    // change side back
+    pos->side ^= 1;
+
+    // parse move
+    int source_square = get_move_source(move);
+    int target_square = get_move_target(move);
+    int promoted_piece = get_move_promoted(move, pos->side);
+    int enpass = get_move_enpassant(move);
+    int castling = get_move_castling(move);
+
+    // init moved piece (promoted pieces used to be pawns)
+    int piece = promoted_piece ? ((pos->side == white) ? P : p) : pos->piece_on[target_square];
+
+    // remove moved (or promoted) piece from the target square
+    pop_bit(pos->bitboards[promoted_piece ? promoted_piece : piece], target_square);
+
+    // put moved piece back on the source square
+    set_bit(pos->bitboards[piece], source_square);
+
+    // move piece back in occupancies
+    pop_bit(pos->occupancies[pos->side], target_square);
+    set_bit(pos->occupancies[pos->side], source_square);
+    pop_bit(pos->occupancies[both], target_square);
+    set_bit(pos->occupancies[both], source_square);
+
+    // move piece back on squares
+    pos->piece_on[target_square] = no_piece;
+    pos->piece_on[source_square] = piece;
+
+    // restore captured piece
+    if (state->captured_piece != no_piece)
+    {
+        // enpassant captured pawn is behind the target square
+        int captured_square = enpass ? ((pos->side == white) ? target_square + 8 : target_square - 8) : target_square;
+
+        // put captured piece back on board
+        set_bit(pos->bitboards[state->captured_piece], captured_square);
+        set_bit(pos->occupancies[pos->side ^ 1], captured_square);
+        set_bit(pos->occupancies[both], captured_square);
+        pos->piece_on[captured_square] = state->captured_piece;
+    }
+
+    // move castling rook back
+    if (castling)
+    {
+        // castling rook's source & target squares
+        U64 rook_squares = 0ULL;
+
+        // switch target square
+        switch (target_square)
+        {
+        // white castles king side
+        case (g1):
+            pop_bit(pos->bitboards[R], f1);
+            set_bit(pos->bitboards[R], h1);
+            pos->piece_on[f1] = no_piece;
+            pos->piece_on[h1] = R;
+            rook_squares = (1ULL << f1) | (1ULL << h1);
+            break;
+
+        // white castles queen side
+        case (c1):
+            pop_bit(pos->bitboards[R], d1);
+            set_bit(pos->bitboards[R], a1);
+            pos->piece_on[d1] = no_piece;
+            pos->piece_on[a1] = R;
+            rook_squares = (1ULL << d1) | (1ULL << a1);
+            break;
+
+        // black castles king side
+        case (g8):
+            pop_bit(pos->bitboards[r], f8);
+            set_bit(pos->bitboards[r], h8);
+            pos->piece_on[f8] = no_piece;
+            pos->piece_on[h8] = r;
+            rook_squares = (1ULL << f8) | (1ULL << h8);
+            break;
+
+        // black castles queen side
+        case (c8):
+            pop_bit(pos->bitboards[r], d8);
+            set_bit(pos->bitboards[r], a8);
+            pos->piece_on[d8] = no_piece;
+            pos->piece_on[a8] = r;
+            rook_squares = (1ULL << d8) | (1ULL << a8);
+            break;
+        }
+
+        // move rook back in occupancies
+        pos->occupancies[pos->side] ^= rook_squares;
+        pos->occupancies[both] ^= rook_squares;
+    }
+
+    // restore irreversible board state
+    pos->castle = state->castle;
+    pos->enpassant = state->enpassant;
+    pos->hash_key = state->hash_key;
+
+#ifdef DEBUG
+    // make sure occupancies & pieces on squares are in sync with piece bitboards
+    verify_board(pos);
+#endif
+}
+
+// make move on chess board
+static inline int make_move(position *pos, int move, int move_flag)
+{
+    // quiet moves (or moves already known to be legal)
+    if (move_flag == all_moves || move_flag == legal_moves)
+    {
+        // parse move
+        int source_square = get_move_source(move);
+        int target_square = get_move_target(move);
+        int piece = pos->piece_on[source_square];
+        int promoted_piece = get_move_promoted(move, pos->side);
+        int capture = get_move_capture(move);
+        int double_push = get_move_double(move);
+        int enpass = get_move_enpassant(move);
+        int castling = get_move_castling(move);
+
+        // push undo record preserving irreversible board state
+        undo *state = &pos->undo_stack[pos->undo_index++];
+        state->captured_piece = no_piece;
+        state->castle = pos->castle;
+        state->enpassant = pos->enpassant;
+        state->hash_key = pos->hash_key;
+
+        // move piece
+        pop_bit(pos->bitboards[piece], source_square);
+        set_bit(pos->bitboards[piece], target_square);
+
+        // init piece on the target square (empty on enpassant captures)
+        int captured_piece = pos->piece_on[target_square];
+
+        // move piece in occupancies
+        pop_bit(pos->occupancies[pos->side], source_square);
+        set_bit(pos->occupancies[pos->side], target_square);
+        pop_bit(pos->occupancies[both], source_square);
+        set_bit(pos->occupancies[both], target_square);
+
+        // move piece on squares
+        pos->piece_on[source_square] = no_piece;
+        pos->piece_on[target_square] = piece;
+
+        // hash piece
+        pos->hash_key ^= piece_keys[piece][source_square]; // remove piece from source square in hash key
+        pos->hash_key ^= piece_keys[piece][target_square]; // set piece to the target square in hash key
+
+        // handling capture moves
+        if (capture && captured_piece != no_piece)
+        {
+            // remove captured piece from corresponding bitboard & opponent's occupancy
+            pop_bit(pos->bitboards[captured_piece], target_square);
+            pop_bit(pos->occupancies[pos->side ^ 1], target_square);
+
+            // remove the piece from hash key
+            pos->hash_key ^= piece_keys[captured_piece][target_square];
+
+            // remember captured piece
+            state->captured_piece = captured_piece;
+        }
+
+        // handle pawn promotions
+        if (promoted_piece)
+        {
+            // white to move
+            if (pos->side == white)
+            {
+                // erase the pawn from the target square
+                pop_bit(pos->bitboards[P], target_square);
+
+                // remove pawn from hash key
+                pos->hash_key ^= piece_keys[P][target_square];
+            }
+
+            // black to move
             else
             {
                 // erase the pawn from the target square
-                pop_bit(bitboards[p], target_square);
+                pop_bit(pos->bitboards[p], target_square);
 
                 // remove pawn from hash key
-                hash_key ^= piece_keys[p][target_square];
+                pos->hash_key ^= piece_keys[p][target_square];
             }
 
             // set up promoted piece on chess board
-            set_bit(bitboards[promoted_piece], target_square);
+            set_bit(pos->bitboards[promoted_piece], target_square);
+            pos->piece_on[target_square] = promoted_piece;
 
             // add promoted piece into the hash key
-            hash_key ^= piece_keys[promoted_piece][target_square];
+            pos->hash_key ^= piece_keys[promoted_piece][target_square];
         }
 
         // handle enpassant captures
         if (enpass)
         {
             // erase the pawn depending on side to move
-            (side == white) ? pop_bit(bitboards[p], target_square + 8) : pop_bit(bitboards[P], target_square - 8);
+            (pos->side == white) ? pop_bit(pos->bitboards[p], target_square + 8) : pop_bit(pos->bitboards[P], target_square - 8);
 
             // white to move
-            if (side == white)
+            if (pos->side == white)
             {
                 // remove captured pawn
-                pop_bit(bitboards[p], target_square + 8);
+                pop_bit(pos->bitboards[p], target_square + 8);
+                pop_bit(pos->occupancies[black], target_square + 8);
+                pop_bit(pos->occupancies[both], target_square + 8);
+                pos->piece_on[target_square + 8] = no_piece;
 
                 // remove pawn from hash key
-                hash_key ^= piece_keys[p][target_square + 8];
+                pos->hash_key ^= piece_keys[p][target_square + 8];
+
+                // remember captured pawn
+                state->captured_piece = p;
             }
 
             // black to move
             else
             {
                 // remove captured pawn
-                pop_bit(bitboards[P], target_square - 8);
+                pop_bit(pos->bitboards[P], target_square - 8);
+                pop_bit(pos->occupancies[white], target_square - 8);
+                pop_bit(pos->occupancies[both], target_square - 8);
+                pos->piece_on[target_square - 8] = no_piece;
 
                 // remove pawn from hash key
-                hash_key ^= piece_keys[P][target_square - 8];
+                pos->hash_key ^= piece_keys[P][target_square - 8];
+
+                // remember captured pawn
+                state->captured_piece = P;
             }
         }
 
         // hash enpassant if available (remove enpassant square from hash key )
-        if (enpassant != no_sq)
-            hash_key ^= enpassant_keys[enpassant];
+        if (pos->enpassant != no_sq)
+            pos->hash_key ^= enpassant_keys[pos->enpassant];
 
         // reset enpassant square
-        enpassant = no_sq;
+        pos->enpassant = no_sq;
 
         // handle double pawn push
         if (double_push)
         {
             // white to move
-            if (side == white)
+            if (pos->side == white)
             {
                 // set enpassant square
-                enpassant = target_square + 8;
+                pos->enpassant = target_square + 8;
 
                 // hash enpassant
-                hash_key ^= enpassant_keys[target_square + 8];
+                pos->hash_key ^= enpassant_keys[target_square + 8];
             }
 
             // black to move
             else
             {
                 // set enpassant square
-                enpassant = target_square - 8;
+                pos->enpassant = target_square - 8;
 
                 // hash enpassant
-                hash_key ^= enpassant_keys[target_square - 8];
+                pos->hash_key ^= enpassant_keys[target_square - 8];
             }
         }
 
         // handle castling moves
         if (castling)
         {
+            // castling rook's source & target squares
+            U64 rook_squares = 0ULL;
+
             // switch target square
             switch (target_square)
             {
             // white castles king side
             case (g1):
                 // move H rook
-                pop_bit(bitboards[R], h1);
-                set_bit(bitboards[R], f1);
+                pop_bit(pos->bitboards[R], h1);
+                set_bit(pos->bitboards[R], f1);
+                pos->piece_on[h1] = no_piece;
+                pos->piece_on[f1] = R;
 
                 // hash rook
-                hash_key ^= piece_keys[R][h1]; // remove rook from h1 from hash key
-                hash_key ^= piece_keys[R][f1]; // put rook on f1 into a hash key
+                pos->hash_key ^= piece_keys[R][h1]; // remove rook from h1 from hash key
+                pos->hash_key ^= piece_keys[R][f1]; // put rook on f1 into a hash key
+
+                // init rook squares
+                rook_squares = (1ULL << h1) | (1ULL << f1);
                 break;
 
             // white castles queen side
             case (c1):
                 // move A rook
-                pop_bit(bitboards[R], a1);
-                set_bit(bitboards[R], d1);
+                pop_bit(pos->bitboards[R], a1);
+                set_bit(pos->bitboards[R], d1);
+                pos->piece_on[a1] = no_piece;
+                pos->piece_on[d1] = R;
 
                 // hash rook
-                hash_key ^= piece_keys[R][a1]; // remove rook from a1 from hash key
-                hash_key ^= piece_keys[R][d1]; // put rook on d1 into a hash key
+                pos->hash_key ^= piece_keys[R][a1]; // remove rook from a1 from hash key
+                pos->hash_key ^= piece_keys[R][d1]; // put rook on d1 into a hash key
+
+                // init rook squares
+                rook_squares = (1ULL << a1) | (1ULL << d1);
                 break;
 
             // black castles king side
             case (g8):
                 // move H rook
-                pop_bit(bitboards[r], h8);
-                set_bit(bitboards[r], f8);
+                pop_bit(pos->bitboards[r], h8);
+                set_bit(pos->bitboards[r], f8);
+                pos->piece_on[h8] = no_piece;
+                pos->piece_on[f8] = r;
 
                 // hash rook
-                hash_key ^= piece_keys[r][h8]; // remove rook from h8 from hash key
-                hash_key ^= piece_keys[r][f8]; // put rook on f8 into a hash key
+                pos->hash_key ^= piece_keys[r][h8]; // remove rook from h8 from hash key
+                pos->hash_key ^= piece_keys[r][f8]; // put rook on f8 into a hash key
+
+                // init rook squares
+                rook_squares = (1ULL << h8) | (1ULL << f8);
                 break;
 
             // black castles queen side
             case (c8):
                 // move A rook
-                pop_bit(bitboards[r], a8);
-                set_bit(bitboards[r], d8);
+                pop_bit(pos->bitboards[r], a8);
+                set_bit(pos->bitboards[r], d8);
+                pos->piece_on[a8] = no_piece;
+                pos->piece_on[d8] = r;
 
                 // hash rook
-                hash_key ^= piece_keys[r][a8]; // remove rook from a8 from hash key
-                hash_key ^= piece_keys[r][d8]; // put rook on d8 into a hash key
+                pos->hash_key ^= piece_keys[r][a8]; // remove rook from a8 from hash key
+                pos->hash_key ^= piece_keys[r][d8]; // put rook on d8 into a hash key
+
+                // init rook squares
+                rook_squares = (1ULL << a8) | (1ULL << d8);
                 break;
             }
+
+            // move rook in occupancies
+            pos->occupancies[pos->side] ^= rook_squares;
+            pos->occupancies[both] ^= rook_squares;
         }
 
         // hash castling
-        hash_key ^= castle_keys[castle];
+        pos->hash_key ^= castle_keys[pos->castle];
 
         // update castling rights
-        castle &= castling_rights[source_square];
-        castle &= castling_rights[target_square];
+        pos->castle &= castling_rights[source_square];
+        pos->castle &= castling_rights[target_square];
 
         // hash castling
-        hash_key ^= castle_keys[castle];
+        pos->hash_key ^= castle_keys[pos->castle];
 
-        // reset occupancies
-        memset(occupancies, 0ULL, 24);
-
-        // loop over white pieces bitboards
-        for (int bb_piece = P; bb_piece <= K; bb_piece++)
-            // update white occupancies
-            occupancies[white] |= bitboards[bb_piece];
-
-        // loop over black pieces bitboards
-        for (int bb_piece = p; bb_piece <= k; bb_piece++)
-            // update black occupancies
-            occupancies[black] |= bitboards[bb_piece];
-
-        // update both sides occupancies
-        occupancies[both] |= occupancies[white];
-        occupancies[both] |= occupancies[black];
+#ifdef DEBUG
+        // make sure occupancies & pieces on squares are in sync with piece bitboards
+        verify_board(pos);
+#endif
 
         // change side
-        side ^= 1;
+        pos->side ^= 1;
 
         // hash side
-        hash_key ^= side_key;
+        pos->hash_key ^= side_key;
+
+        // moves coming from the legal move generator can't expose the king
+        if (move_flag == legal_moves)
+            // return legal move
+            return 1;
 
         // make sure that king has not been exposed into a check
-        if (is_square_attacked((side == white) ? get_ls1b_index(bitboards[k]) : get_ls1b_index(bitboards[K]), side))
+        if (is_square_attacked(pos, (pos->side == white) ? get_ls1b_index(pos->bitboards[k]) : get_ls1b_index(pos->bitboards[K]), pos->side))
         {
             // take move back
-            take_back();
+            unmake_move(pos, move);
 
             // return illegal move
             return 0;
@@ -2300,7 +2922,7 @@ static inline int make_move(int move, int move_flag)
     {
         // make sure move is the capture
         if (get_move_capture(move))
-            make_move(move, all_moves);
+            return make_move(pos, move, all_moves);
 
         // otherwise the move is not a capture
         else
@@ -2309,520 +2931,3692 @@ static inline int make_move(int move, int move_flag)
     }
 }
 
-// generate all moves
-static inline void generate_moves(moves *move_list)
+/*
+    Move generators are written once for both colours and take the side
+    to move as an argument. Forcing them inline into per-colour entry
+    points turns the side into a compile time constant, so every colour
+    dependent choice (piece codes, occupancies, pawn shifts, castling
+    squares) is resolved by the compiler instead of branched on.
+*/
+
+// always inline a function so constant arguments specialize its code
+#define force_inline static inline __attribute__((always_inline))
+
+// add moves of a given piece from source square to every target square
+static inline void add_piece_moves(moves *move_list, int source_square, U64 targets, int flags)
 {
-    // init move count
-    move_list->count = 0;
+    // loop over target squares
+    while (targets)
+    {
+        // init target square
+        int target_square = get_ls1b_index(targets);
 
-    // define source & target squares
-    int source_square, target_square;
+        // add move
+        add_move(move_list, encode_move(source_square, target_square, flags));
 
-    // define current piece's bitboard copy & it's attacks
-    U64 bitboard, attacks;
+        // pop ls1b in current targets set
+        pop_bit(targets, target_square);
+    }
+}
 
-    // loop over all the bitboards
-    for (int piece = P; piece <= k; piece++)
+/*
+    Pawn moves are generated setwise: all pawns are shifted at once
+    towards their targets, so source squares are recovered from target
+    squares by a fixed offset instead of looping pawn by pawn.
+*/
+
+// rank masks for pawn moves
+#define rank_8 0x00000000000000FFULL
+#define rank_5 0x00000000FF000000ULL
+#define rank_4 0x000000FF00000000ULL
+#define rank_1 0xFF00000000000000ULL
+
+// add pawn moves to every target square, source square lies at target square + offset
+static inline void add_pawn_targets(moves *move_list, U64 targets, int offset, U64 promotion_rank, int flags)
+{
+    // promotions
+    U64 promotions = targets & promotion_rank;
+
+    // loop over promotion target squares
+    while (promotions)
     {
-        // init piece bitboard copy
-        bitboard = bitboards[piece];
+        // init target square
+        int target_square = get_ls1b_index(promotions);
 
-        // generate white pawns & white king castling moves
-        if (side == white)
-        {
-            // pick up white pawn bitboards index
-            if (piece == P)
-            {
-                // loop over white pawns within white pawn bitboard
-                while (bitboard)
-                {
-                    // init source square
-                    source_square = get_ls1b_index(bitboard);
+        // add all four promotions
+        add_move(move_list, encode_move((target_square + offset), target_square, promotion_flags(Q, flags)));
+        add_move(move_list, encode_move((target_square + offset), target_square, promotion_flags(R, flags)));
+        add_move(move_list, encode_move((target_square + offset), target_square, promotion_flags(B, flags)));
+        add_move(move_list, encode_move((target_square + offset), target_square, promotion_flags(N, flags)));
 
-                    // init target square
-                    target_square = source_square - 8;
+        // pop ls1b of promotion targets
+        pop_bit(promotions, target_square);
+    }
 
-                    // generate quiet pawn moves
-                    if (!(target_square < a8) && !get_bit(occupancies[both], target_square))
-                    {
-                        // pawn promotion
-                        if (source_square >= a7 && source_square <= h7)
-                        {
-                            add_move(move_list, encode_move(source_square, target_square, piece, Q, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, R, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, B, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, N, 0, 0, 0, 0));
-                        }
-
-                        else
-                        {
-                            // one square ahead pawn move
-                            add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
-
-                            // two squares ahead pawn move
-                            if ((source_square >= a2 && source_square <= h2) && !get_bit(occupancies[both], target_square - 8))
-                                add_move(move_list, encode_move(source_square, target_square - 8, piece, 0, 0, 1, 0, 0));
-                        }
-                    }
+    // regular pawn moves
+    targets &= ~promotion_rank;
 
-                    // init pawn attacks bitboard
-                    attacks = pawn_attacks[side][source_square] & occupancies[black];
+    // loop over regular target squares
+    while (targets)
+    {
+        // init target square
+        int target_square = get_ls1b_index(targets);
 
-                    // generate pawn captures
-                    while (attacks)
-                    {
-                        // init target square
-                        target_square = get_ls1b_index(attacks);
-
-                        // pawn promotion
-                        if (source_square >= a7 && source_square <= h7)
-                        {
-                            add_move(move_list, encode_move(source_square, target_square, piece, Q, 1, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, R, 1, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, B, 1, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, N, 1, 0, 0, 0));
-                        }
-
-                        else
-                            // one square ahead pawn move
-                            add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));
-
-                        // pop ls1b of the pawn attacks
-                        pop_bit(attacks, target_square);
-                    }
+        // add pawn move
+        add_move(move_list, encode_move((target_square + offset), target_square, flags));
 
-                    // generate enpassant captures
-                    if (enpassant != no_sq)
-                    {
-                        // lookup pawn attacks and bitwise AND with enpassant square (bit)
-                        U64 enpassant_attacks = pawn_attacks[side][source_square] & (1ULL << enpassant);
-
-                        // make sure enpassant capture available
-                        if (enpassant_attacks)
-                        {
-                            // init enpassant capture target square
-                            int target_enpassant = get_ls1b_index(enpassant_attacks);
-                            add_move(move_list, encode_move(source_square, target_enpassant, piece, 0, 1, 0, 1, 0));
-                        }
-                    }
+        // pop ls1b of pawn targets
+        pop_bit(targets, target_square);
+    }
+}
 
-                    // pop ls1b from piece bitboard copy
-                    pop_bit(bitboard, source_square);
-                }
-            }
+// generate pushes, captures & promotions of given pawns restricted to target mask (enpassant excluded)
+force_inline void generate_pawn_moves(position *pos, moves *move_list, U64 pawns, U64 target_mask, int move_flag, int side)
+{
+    // init empty squares & enemy pieces
+    U64 empty = ~pos->occupancies[both];
+    U64 enemy_occupancy = pos->occupancies[side ^ 1];
 
-            // castling moves
-            if (piece == K)
-            {
-                // king side castling is available
-                if (castle & wk)
-                {
-                    // make sure square between king and king's rook are empty
-                    if (!get_bit(occupancies[both], f1) && !get_bit(occupancies[both], g1))
-                    {
-                        // make sure king and the f1 squares are not under attacks
-                        if (!is_square_attacked(e1, black) && !is_square_attacked(f1, black))
-                            add_move(move_list, encode_move(e1, g1, piece, 0, 0, 0, 0, 1));
-                    }
-                }
+    // init pushes & captures to the left and to the right (from white's point of view)
+    U64 single_pushes, double_pushes, left_captures, right_captures;
 
-                // queen side castling is available
-                if (castle & wq)
-                {
-                    // make sure square between king and queen's rook are empty
-                    if (!get_bit(occupancies[both], d1) && !get_bit(occupancies[both], c1) && !get_bit(occupancies[both], b1))
-                    {
-                        // make sure king and the d1 squares are not under attacks
-                        if (!is_square_attacked(e1, black) && !is_square_attacked(d1, black))
-                            add_move(move_list, encode_move(e1, c1, piece, 0, 0, 0, 0, 1));
-                    }
-                }
-            }
-        }
+    // init promotion rank & move direction
+    int push;
+    U64 promotion_rank;
 
-        // generate black pawns & black king castling moves
-        else
-        {
-            // pick up black pawn bitboards index
-            if (piece == p)
-            {
-                // loop over white pawns within white pawn bitboard
-                while (bitboard)
-                {
-                    // init source square
-                    source_square = get_ls1b_index(bitboard);
+    // white pawns move up the board (towards lower square indices)
+    if (side == white)
+    {
+        push = -8;
+        promotion_rank = rank_8;
+        single_pushes = (pawns >> 8) & empty;
+        double_pushes = (single_pushes >> 8) & empty & rank_4;
+        left_captures = ((pawns >> 9) & not_h_file) & enemy_occupancy;
+        right_captures = ((pawns >> 7) & not_a_file) & enemy_occupancy;
+    }
 
-                    // init target square
-                    target_square = source_square + 8;
+    // black pawns move down the board (towards higher square indices)
+    else
+    {
+        push = 8;
+        promotion_rank = rank_1;
+        single_pushes = (pawns << 8) & empty;
+        double_pushes = (single_pushes << 8) & empty & rank_5;
+        left_captures = ((pawns << 7) & not_h_file) & enemy_occupancy;
+        right_captures = ((pawns << 9) & not_a_file) & enemy_occupancy;
+    }
 
-                    // generate quiet pawn moves
-                    if (!(target_square > h1) && !get_bit(occupancies[both], target_square))
-                    {
-                        // pawn promotion
-                        if (source_square >= a2 && source_square <= h2)
-                        {
-                            add_move(move_list, encode_move(source_square, target_square, piece, q, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, r, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, b, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, n, 0, 0, 0, 0));
-                        }
-
-                        else
-                        {
-                            // one square ahead pawn move
-                            add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
-
-                            // two squares ahead pawn move
-                            if ((source_square >= a7 && source_square <= h7) && !get_bit(occupancies[both], target_square + 8))
-                                add_move(move_list, encode_move(source_square, target_square + 8, piece, 0, 0, 1, 0, 0));
-                        }
-                    }
+    // only pushes onto promotion rank count as captures
+    if (move_flag == only_captures)
+    {
+        single_pushes &= promotion_rank;
+        double_pushes = 0ULL;
+    }
 
-                    // init pawn attacks bitboard
-                    attacks = pawn_attacks[side][source_square] & occupancies[white];
+    // add pawn pushes
+    add_pawn_targets(move_list, single_pushes & target_mask, -push, promotion_rank, quiet_flag);
+    add_pawn_targets(move_list, double_pushes & target_mask, -2 * push, promotion_rank, double_push_flag);
 
-                    // generate pawn captures
-                    while (attacks)
-                    {
-                        // init target square
-                        target_square = get_ls1b_index(attacks);
-
-                        // pawn promotion
-                        if (source_square >= a2 && source_square <= h2)
-                        {
-                            add_move(move_list, encode_move(source_square, target_square, piece, q, 1, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, r, 1, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, b, 1, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, n, 1, 0, 0, 0));
-                        }
-
-                        else
-                            // one square ahead pawn move
-                            add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));
-
-                        // pop ls1b of the pawn attacks
-                        pop_bit(attacks, target_square);
-                    }
+    // add pawn captures
+    add_pawn_targets(move_list, left_captures & target_mask, -push + 1, promotion_rank, capture_flag);
+    add_pawn_targets(move_list, right_captures & target_mask, -push - 1, promotion_rank, capture_flag);
+}
 
-                    // generate enpassant captures
-                    if (enpassant != no_sq)
-                    {
-                        // lookup pawn attacks and bitwise AND with enpassant square (bit)
-                        U64 enpassant_attacks = pawn_attacks[side][source_square] & (1ULL << enpassant);
-
-                        // make sure enpassant capture available
-                        if (enpassant_attacks)
-                        {
-                            // init enpassant capture target square
-                            int target_enpassant = get_ls1b_index(enpassant_attacks);
-                            add_move(move_list, encode_move(source_square, target_enpassant, piece, 0, 1, 0, 1, 0));
-                        }
-                    }
+// generate all pseudo legal moves of a given side
+force_inline void generate_side_moves(position *pos, moves *move_list, int side)
+{
+    // init move count
+    move_list->count = 0;
 
-                    // pop ls1b from piece bitboard copy
-                    pop_bit(bitboard, source_square);
-                }
-            }
+    // define source square
+    int source_square;
 
-            // castling moves
-            if (piece == k)
-            {
-                // king side castling is available
-                if (castle & bk)
-                {
-                    // make sure square between king and king's rook are empty
-                    if (!get_bit(occupancies[both], f8) && !get_bit(occupancies[both], g8))
-                    {
-                        // make sure king and the f8 squares are not under attacks
-                        if (!is_square_attacked(e8, white) && !is_square_attacked(f8, white))
-                            add_move(move_list, encode_move(e8, g8, piece, 0, 0, 0, 0, 1));
-                    }
-                }
+    // define current piece's bitboard copy & it's attacks
+    U64 bitboard, attacks;
 
-                // queen side castling is available
-                if (castle & bq)
-                {
-                    // make sure square between king and queen's rook are empty
-                    if (!get_bit(occupancies[both], d8) && !get_bit(occupancies[both], c8) && !get_bit(occupancies[both], b8))
-                    {
-                        // make sure king and the d8 squares are not under attacks
-                        if (!is_square_attacked(e8, white) && !is_square_attacked(d8, white))
-                            add_move(move_list, encode_move(e8, c8, piece, 0, 0, 0, 0, 1));
-                    }
-                }
-            }
-        }
+    // init piece offset of the side to move
+    int our = (side == white) ? P : p;
 
-        // genarate knight moves
-        if ((side == white) ? piece == N : piece == n)
-        {
-            // loop over source squares of piece bitboard copy
-            while (bitboard)
-            {
-                // init source square
-                source_square = get_ls1b_index(bitboard);
+    // init occupancies
+    U64 own_occupancy = pos->occupancies[side];
+    U64 enemy_occupancy = pos->occupancies[side ^ 1];
 
-                // init piece attacks in order to get set of target squares
-                attacks = knight_attacks[source_square] & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
+    // generate pawn pushes, captures & promotions
+    generate_pawn_moves(pos, move_list, pos->bitboards[our + P], ~0ULL, all_moves, side);
 
-                // loop over target squares available from generated attacks
-                while (attacks)
-                {
-                    // init target square
-                    target_square = get_ls1b_index(attacks);
+    // generate enpassant captures
+    if (pos->enpassant != no_sq)
+    {
+        // pawns attacking enpassant square
+        bitboard = pawn_attacks[side ^ 1][pos->enpassant] & pos->bitboards[our + P];
 
-                    // quiet move
-                    if (!get_bit(((side == white) ? occupancies[black] : occupancies[white]), target_square))
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
+        // loop over pawns able to capture enpassant
+        while (bitboard)
+        {
+            // init source square
+            source_square = get_ls1b_index(bitboard);
+            add_move(move_list, encode_move(source_square, pos->enpassant, enpassant_flag));
 
-                    else
-                        // capture move
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));
+            // pop ls1b of the pawns
+            pop_bit(bitboard, source_square);
+        }
+    }
 
-                    // pop ls1b in current attacks set
-                    pop_bit(attacks, target_square);
-                }
+    // white castling moves
+    if (side == white)
+    {
+        // king side castling is available
+        if (pos->castle & wk)
+        {
+            // make sure square between king and king's rook are empty
+            if (!get_bit(pos->occupancies[both], f1) && !get_bit(pos->occupancies[both], g1))
+            {
+                // make sure king and the f1 squares are not under attacks
+                if (!is_square_attacked(pos, e1, black) && !is_square_attacked(pos, f1, black))
+                    add_move(move_list, encode_move(e1, g1, castling_flag));
+            }
+        }
+
+        // queen side castling is available
+        if (pos->castle & wq)
+        {
+            // make sure square between king and queen's rook are empty
+            if (!get_bit(pos->occupancies[both], d1) && !get_bit(pos->occupancies[both], c1) && !get_bit(pos->occupancies[both], b1))
+            {
+                // make sure king and the d1 squares are not under attacks
+                if (!is_square_attacked(pos, e1, black) && !is_square_attacked(pos, d1, black))
+                    add_move(move_list, encode_move(e1, c1, castling_flag));
+            }
+        }
+    }
 
-                // pop ls1b of the current piece bitboard copy
-                pop_bit(bitboard, source_square);
+    // black castling moves
+    else
+    {
+        // king side castling is available
+        if (pos->castle & bk)
+        {
+            // make sure square between king and king's rook are empty
+            if (!get_bit(pos->occupancies[both], f8) && !get_bit(pos->occupancies[both], g8))
+            {
+                // make sure king and the f8 squares are not under attacks
+                if (!is_square_attacked(pos, e8, white) && !is_square_attacked(pos, f8, white))
+                    add_move(move_list, encode_move(e8, g8, castling_flag));
             }
         }
 
-        // generate bishop moves
-        if ((side == white) ? piece == B : piece == b)
+        // queen side castling is available
+        if (pos->castle & bq)
         {
-            // loop over source squares of piece bitboard copy
-            while (bitboard)
+            // make sure square between king and queen's rook are empty
+            if (!get_bit(pos->occupancies[both], d8) && !get_bit(pos->occupancies[both], c8) && !get_bit(pos->occupancies[both], b8))
             {
-                // init source square
-                source_square = get_ls1b_index(bitboard);
+                // make sure king and the d8 squares are not under attacks
+                if (!is_square_attacked(pos, e8, white) && !is_square_attacked(pos, d8, white))
+                    add_move(move_list, encode_move(e8, c8, castling_flag));
+            }
+        }
+    }
 
-                // init piece attacks in order to get set of target squares
-                attacks = get_bishop_attacks(source_square, occupancies[both]) & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
+    // knight moves
+    bitboard = pos->bitboards[our + N];
 
-                // loop over target squares available from generated attacks
-                while (attacks)
-                {
-                    // init target square
-                    target_square = get_ls1b_index(attacks);
+    // loop over knights
+    while (bitboard)
+    {
+        // init source square
+        source_square = get_ls1b_index(bitboard);
 
-                    // quiet move
-                    if (!get_bit(((side == white) ? occupancies[black] : occupancies[white]), target_square))
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
+        // init knight attacks
+        attacks = knight_attacks[source_square] & ~own_occupancy;
 
-                    else
-                        // capture move
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));
+        // add captures & quiet moves
+        add_piece_moves(move_list, source_square, attacks & enemy_occupancy, capture_flag);
+        add_piece_moves(move_list, source_square, attacks & ~enemy_occupancy, quiet_flag);
 
-                    // pop ls1b in current attacks set
-                    pop_bit(attacks, target_square);
-                }
+        // pop ls1b of the current piece bitboard copy
+        pop_bit(bitboard, source_square);
+    }
 
-                // pop ls1b of the current piece bitboard copy
-                pop_bit(bitboard, source_square);
-            }
-        }
+    // bishop moves
+    bitboard = pos->bitboards[our + B];
 
-        // generate rook moves
-        if ((side == white) ? piece == R : piece == r)
-        {
-            // loop over source squares of piece bitboard copy
-            while (bitboard)
-            {
-                // init source square
-                source_square = get_ls1b_index(bitboard);
+    // loop over bishops
+    while (bitboard)
+    {
+        // init source square
+        source_square = get_ls1b_index(bitboard);
 
-                // init piece attacks in order to get set of target squares
-                attacks = get_rook_attacks(source_square, occupancies[both]) & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
+        // init bishop attacks
+        attacks = get_bishop_attacks(source_square, pos->occupancies[both]) & ~own_occupancy;
 
-                // loop over target squares available from generated attacks
-                while (attacks)
-                {
-                    // init target square
-                    target_square = get_ls1b_index(attacks);
+        // add captures & quiet moves
+        add_piece_moves(move_list, source_square, attacks & enemy_occupancy, capture_flag);
+        add_piece_moves(move_list, source_square, attacks & ~enemy_occupancy, quiet_flag);
 
-                    // quiet move
-                    if (!get_bit(((side == white) ? occupancies[black] : occupancies[white]), target_square))
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
+        // pop ls1b of the current piece bitboard copy
+        pop_bit(bitboard, source_square);
+    }
 
-                    else
-                        // capture move
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));
+    // rook moves
+    bitboard = pos->bitboards[our + R];
 
-                    // pop ls1b in current attacks set
-                    pop_bit(attacks, target_square);
-                }
+    // loop over rooks
+    while (bitboard)
+    {
+        // init source square
+        source_square = get_ls1b_index(bitboard);
 
-                // pop ls1b of the current piece bitboard copy
-                pop_bit(bitboard, source_square);
-            }
-        }
+        // init rook attacks
+        attacks = get_rook_attacks(source_square, pos->occupancies[both]) & ~own_occupancy;
 
-        // generate queen moves
-        if ((side == white) ? piece == Q : piece == q)
-        {
-            // loop over source squares of piece bitboard copy
-            while (bitboard)
-            {
-                // init source square
-                source_square = get_ls1b_index(bitboard);
+        // add captures & quiet moves
+        add_piece_moves(move_list, source_square, attacks & enemy_occupancy, capture_flag);
+        add_piece_moves(move_list, source_square, attacks & ~enemy_occupancy, quiet_flag);
 
-                // init piece attacks in order to get set of target squares
-                attacks = get_queen_attacks(source_square, occupancies[both]) & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
+        // pop ls1b of the current piece bitboard copy
+        pop_bit(bitboard, source_square);
+    }
 
-                // loop over target squares available from generated attacks
-                while (attacks)
-                {
-                    // init target square
-                    target_square = get_ls1b_index(attacks);
+    // queen moves
+    bitboard = pos->bitboards[our + Q];
 
-                    // quiet move
-                    if (!get_bit(((side == white) ? occupancies[black] : occupancies[white]), target_square))
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
+    // loop over queens
+    while (bitboard)
+    {
+        // init source square
+        source_square = get_ls1b_index(bitboard);
 
-                    else
-                        // capture move
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));
+        // init queen attacks
+        attacks = get_queen_attacks(source_square, pos->occupancies[both]) & ~own_occupancy;
 
-                    // pop ls1b in current attacks set
-                    pop_bit(attacks, target_square);
-                }
+        // add captures & quiet moves
+        add_piece_moves(move_list, source_square, attacks & enemy_occupancy, capture_flag);
+        add_piece_moves(move_list, source_square, attacks & ~enemy_occupancy, quiet_flag);
 
-                // pop ls1b of the current piece bitboard copy
-                pop_bit(bitboard, source_square);
-            }
-        }
+        // pop ls1b of the current piece bitboard copy
+        pop_bit(bitboard, source_square);
+    }
 
-        // generate king moves
-        if ((side == white) ? piece == K : piece == k)
-        {
-            // loop over source squares of piece bitboard copy
-            while (bitboard)
-            {
-                // init source square
-                source_square = get_ls1b_index(bitboard);
+    // init king square
+    source_square = get_ls1b_index(pos->bitboards[our + K]);
 
-                // init piece attacks in order to get set of target squares
-                attacks = king_attacks[source_square] & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
+    // init king attacks
+    attacks = king_attacks[source_square] & ~own_occupancy;
 
-                // loop over target squares available from generated attacks
-                while (attacks)
-                {
-                    // init target square
-                    target_square = get_ls1b_index(attacks);
+    // add king captures & quiet moves
+    add_piece_moves(move_list, source_square, attacks & enemy_occupancy, capture_flag);
+    add_piece_moves(move_list, source_square, attacks & ~enemy_occupancy, quiet_flag);
+}
 
-                    // quiet move
-                    if (!get_bit(((side == white) ? occupancies[black] : occupancies[white]), target_square))
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
+// generate all pseudo legal white moves
+static inline void generate_white_moves(position *pos, moves *move_list)
+{
+    // specialize generator for white
+    generate_side_moves(pos, move_list, white);
+}
 
-                    else
-                        // capture move
-                        add_move(move_list, encode_move(source_square, target_square, piece, 0, 1, 0, 0, 0));
+// generate all pseudo legal black moves
+static inline void generate_black_moves(position *pos, moves *move_list)
+{
+    // specialize generator for black
+    generate_side_moves(pos, move_list, black);
+}
 
-                    // pop ls1b in current attacks set
-                    pop_bit(attacks, target_square);
-                }
+// generate all moves
+static inline void generate_moves(position *pos, moves *move_list)
+{
+    // pick up generator specialized for the side to move
+    if (pos->side == white)
+        generate_white_moves(pos, move_list);
 
-                // pop ls1b of the current piece bitboard copy
-                pop_bit(bitboard, source_square);
-            }
-        }
-    }
+    else
+        generate_black_moves(pos, move_list);
 }
 
 /**********************************\
  ==================================
 
-               Perft
+        Legal move generator
 
  ==================================
 \**********************************/
 
-// leaf nodes (number of positions reached during the test of the move generator at a given depth)
-U64 nodes;
+/*
+    The legal move generator computes checkers and pinned pieces once
+    per node and then masks the target squares of every piece so that
+    each generated move is legal by construction:
+
+      check mask   squares that resolve a single check (capture the
+                   checker or block the ray), all squares when not in check
+      pin mask     the line through the king and a pinned piece which
+                   the pinned piece isn't allowed to leave
+      double check only king moves are generated
+*/
+
+#ifndef BAKED_TABLES
+// squares strictly between two aligned squares [square][square]
+U64 between_masks[64][64];
+
+// entire rank, file or diagonal going through two aligned squares [square][square]
+U64 line_masks[64][64];
+#endif
 
-// perft driver
-static inline void perft_driver(int depth)
+// init between & line masks
+void init_line_masks()
 {
-    // reccursion escape condition
-    if (depth == 0)
+    // loop over source squares
+    for (int source_square = 0; source_square < 64; source_square++)
     {
-        // increment nodes count (count reached positions)
-        nodes++;
-        return;
-    }
+        // loop over target squares
+        for (int target_square = 0; target_square < 64; target_square++)
+        {
+            // init source & target square bitboards
+            U64 source_bitboard = 1ULL << source_square;
+            U64 target_bitboard = 1ULL << target_square;
 
-    // create move list instance
-    moves move_list[1];
+            // squares are on the same rank or file
+            if (source_square != target_square && (rook_attacks_on_the_fly(source_square, 0ULL) & target_bitboard))
+            {
+                between_masks[source_square][target_square] = rook_attacks_on_the_fly(source_square, target_bitboard) &
+                                                              rook_attacks_on_the_fly(target_square, source_bitboard);
 
-    // generate moves
-    generate_moves(move_list);
+                line_masks[source_square][target_square] = (rook_attacks_on_the_fly(source_square, 0ULL) &
+                                                            rook_attacks_on_the_fly(target_square, 0ULL)) |
+                                                           source_bitboard | target_bitboard;
+            }
 
-    // loop over generated moves
-    for (int move_count = 0; move_count < move_list->count; move_count++)
-    {
+            // squares are on the same diagonal
+            else if (source_square != target_square && (bishop_attacks_on_the_fly(source_square, 0ULL) & target_bitboard))
+            {
+                between_masks[source_square][target_square] = bishop_attacks_on_the_fly(source_square, target_bitboard) &
+                                                              bishop_attacks_on_the_fly(target_square, source_bitboard);
+
+                line_masks[source_square][target_square] = (bishop_attacks_on_the_fly(source_square, 0ULL) &
+                                                            bishop_attacks_on_the_fly(target_square, 0ULL)) |
+                                                           source_bitboard | target_bitboard;
+            }
+        }
+    }
+}
+
+/*
+    Legal move generator is shared by the full and the captures-only
+    move lists: with only_captures flag target squares are masked by
+    enemy occupancy up front, so no quiet move is ever generated apart
+    from pawn pushes onto the promotion rank.
+*/
+
+// generate legal moves of a given move type (all_moves or only_captures) & side
+force_inline void generate_legal(position *pos, moves *move_list, int move_flag, int side)
+{
+    // init move count
+    move_list->count = 0;
+
+    // define source & target squares
+    int source_square, target_square;
+
+    // define current piece's bitboard copy & it's attacks
+    U64 bitboard, attacks;
+
+    // init piece offsets of the side to move and of the opponent
+    int our = (side == white) ? P : p;
+    int their = (side == white) ? p : P;
+
+    // init occupancies
+    U64 own_occupancy = pos->occupancies[side];
+    U64 enemy_occupancy = pos->occupancies[side ^ 1];
+
+    // init target squares of the pieces (enemy pieces only when generating captures)
+    U64 target_mask = (move_flag == only_captures) ? enemy_occupancy : ~own_occupancy;
+
+    // init king square
+    int king_square = get_ls1b_index(pos->bitboards[our + K]);
+
+    // init enemy sliders
+    U64 enemy_diagonal = pos->bitboards[their + B] | pos->bitboards[their + Q];
+    U64 enemy_orthogonal = pos->bitboards[their + R] | pos->bitboards[their + Q];
+
+    // pieces giving check to our king
+    U64 checkers = attackers_to(pos, king_square, pos->occupancies[both]) & enemy_occupancy;
+
+    // enemy sliders that would attack our king if our pieces weren't there
+    U64 snipers = attackers_to(pos, king_square, enemy_occupancy) & (enemy_diagonal | enemy_orthogonal);
+
+    // our pieces pinned to the king
+    U64 pinned = 0ULL;
+
+    // loop over snipers
+    while (snipers)
+    {
+        // init sniper square
+        int sniper_square = get_ls1b_index(snipers);
+
+        // pieces in between the king and the sniper
+        U64 blockers = between_masks[king_square][sniper_square] & pos->occupancies[both];
+
+        // single own blocker is pinned
+        if (blockers && !(blockers & (blockers - 1)) && (blockers & own_occupancy))
+            pinned |= blockers;
+
+        // pop ls1b of the snipers
+        pop_bit(snipers, sniper_square);
+    }
+
+    // king moves: target squares must not be attacked once the king has left its square
+    attacks = king_attacks[king_square] & target_mask;
+
+    // loop over king target squares
+    while (attacks)
+    {
+        // init target square
+        target_square = get_ls1b_index(attacks);
+
+        // make sure target square is safe
+        if (!(attackers_to(pos, target_square, pos->occupancies[both] ^ (1ULL << king_square)) & enemy_occupancy))
+            add_move(move_list, encode_move(king_square, target_square, (get_bit(enemy_occupancy, target_square) ? capture_flag : quiet_flag)));
+
+        // pop ls1b in current attacks set
+        pop_bit(attacks, target_square);
+    }
+
+    // in double check only king moves are legal
+    if (checkers & (checkers - 1))
+        return;
+
+    // init check mask (capture the checker or block its ray)
+    U64 check_mask = checkers ? (between_masks[king_square][get_ls1b_index(checkers)] | checkers) : ~0ULL;
+
+    // castling moves (only when not in check & generating quiet moves)
+    if (!checkers && move_flag == all_moves)
+    {
+        // white to move
+        if (side == white)
+        {
+            // king side castling
+            if ((pos->castle & wk) && !get_bit(pos->occupancies[both], f1) && !get_bit(pos->occupancies[both], g1) &&
+                !is_square_attacked(pos, f1, black) && !is_square_attacked(pos, g1, black))
+                add_move(move_list, encode_move(e1, g1, castling_flag));
+
+            // queen side castling
+            if ((pos->castle & wq) && !get_bit(pos->occupancies[both], d1) && !get_bit(pos->occupancies[both], c1) && !get_bit(pos->occupancies[both], b1) &&
+                !is_square_attacked(pos, d1, black) && !is_square_attacked(pos, c1, black))
+                add_move(move_list, encode_move(e1, c1, castling_flag));
+        }
+
+        // black to move
+        else
+        {
+            // king side castling
+            if ((pos->castle & bk) && !get_bit(pos->occupancies[both], f8) && !get_bit(pos->occupancies[both], g8) &&
+                !is_square_attacked(pos, f8, white) && !is_square_attacked(pos, g8, white))
+                add_move(move_list, encode_move(e8, g8, castling_flag));
+
+            // queen side castling
+            if ((pos->castle & bq) && !get_bit(pos->occupancies[both], d8) && !get_bit(pos->occupancies[both], c8) && !get_bit(pos->occupancies[both], b8) &&
+                !is_square_attacked(pos, d8, white) && !is_square_attacked(pos, c8, white))
+                add_move(move_list, encode_move(e8, c8, castling_flag));
+        }
+    }
+
+    // unpinned pawns move setwise
+    generate_pawn_moves(pos, move_list, pos->bitboards[our + P] & ~pinned, check_mask, move_flag, side);
+
+    // pinned pawns
+    bitboard = pos->bitboards[our + P] & pinned;
+
+    // loop over pinned pawns
+    while (bitboard)
+    {
+        // init source square
+        source_square = get_ls1b_index(bitboard);
+
+        // pinned pawns can only move along the pin ray
+        generate_pawn_moves(pos, move_list, 1ULL << source_square, check_mask & line_masks[king_square][source_square], move_flag, side);
+
+        // pop ls1b from piece bitboard copy
+        pop_bit(bitboard, source_square);
+    }
+
+    // generate enpassant captures
+    if (pos->enpassant != no_sq)
+    {
+        // init square of the pawn being captured
+        int captured_square = pos->enpassant + ((side == white) ? 8 : -8);
+
+        // pawns attacking enpassant square
+        bitboard = pawn_attacks[side ^ 1][pos->enpassant] & pos->bitboards[our + P];
+
+        // loop over pawns able to capture enpassant
+        while (bitboard)
+        {
+            // init source square
+            source_square = get_ls1b_index(bitboard);
+
+            // board occupancy after the enpassant capture
+            U64 occupancy = (pos->occupancies[both] ^ (1ULL << source_square) ^ (1ULL << captured_square)) | (1ULL << pos->enpassant);
+
+            // make sure king isn't left in check by a leaper or exposed to a slider
+            if (!(checkers & (pos->bitboards[their + P] | pos->bitboards[their + N]) & ~(1ULL << captured_square)) &&
+                !(get_bishop_attacks(king_square, occupancy) & enemy_diagonal) &&
+                !(get_rook_attacks(king_square, occupancy) & enemy_orthogonal))
+                add_move(move_list, encode_move(source_square, pos->enpassant, enpassant_flag));
+
+            // pop ls1b from piece bitboard copy
+            pop_bit(bitboard, source_square);
+        }
+    }
+
+    // knight moves (pinned knights can never move)
+    bitboard = pos->bitboards[our + N] & ~pinned;
+
+    // loop over knights
+    while (bitboard)
+    {
+        // init source square
+        source_square = get_ls1b_index(bitboard);
+
+        // init knight attacks
+        attacks = knight_attacks[source_square] & target_mask & check_mask;
+
+        // add knight moves
+        add_piece_moves(move_list, source_square, attacks & enemy_occupancy, capture_flag);
+        add_piece_moves(move_list, source_square, attacks & ~enemy_occupancy, quiet_flag);
+
+        // pop ls1b of the current piece bitboard copy
+        pop_bit(bitboard, source_square);
+    }
+
+    // bishop moves
+    bitboard = pos->bitboards[our + B];
+
+    // loop over bishops
+    while (bitboard)
+    {
+        // init source square
+        source_square = get_ls1b_index(bitboard);
+
+        // init bishop attacks
+        attacks = get_bishop_attacks(source_square, pos->occupancies[both]) & target_mask & check_mask;
+
+        // pinned bishops can only move along the pin ray
+        if (get_bit(pinned, source_square))
+            attacks &= line_masks[king_square][source_square];
+
+        // add bishop moves
+        add_piece_moves(move_list, source_square, attacks & enemy_occupancy, capture_flag);
+        add_piece_moves(move_list, source_square, attacks & ~enemy_occupancy, quiet_flag);
+
+        // pop ls1b of the current piece bitboard copy
+        pop_bit(bitboard, source_square);
+    }
+
+    // rook moves
+    bitboard = pos->bitboards[our + R];
+
+    // loop over rooks
+    while (bitboard)
+    {
+        // init source square
+        source_square = get_ls1b_index(bitboard);
+
+        // init rook attacks
+        attacks = get_rook_attacks(source_square, pos->occupancies[both]) & target_mask & check_mask;
+
+        // pinned rooks can only move along the pin ray
+        if (get_bit(pinned, source_square))
+            attacks &= line_masks[king_square][source_square];
+
+        // add rook moves
+        add_piece_moves(move_list, source_square, attacks & enemy_occupancy, capture_flag);
+        add_piece_moves(move_list, source_square, attacks & ~enemy_occupancy, quiet_flag);
+
+        // pop ls1b of the current piece bitboard copy
+        pop_bit(bitboard, source_square);
+    }
+
+    // queen moves
+    bitboard = pos->bitboards[our + Q];
+
+    // loop over queens
+    while (bitboard)
+    {
+        // init source square
+        source_square = get_ls1b_index(bitboard);
+
+        // init queen attacks
+        attacks = get_queen_attacks(source_square, pos->occupancies[both]) & target_mask & check_mask;
+
+        // pinned queens can only move along the pin ray
+        if (get_bit(pinned, source_square))
+            attacks &= line_masks[king_square][source_square];
+
+        // add queen moves
+        add_piece_moves(move_list, source_square, attacks & enemy_occupancy, capture_flag);
+        add_piece_moves(move_list, source_square, attacks & ~enemy_occupancy, quiet_flag);
+
+        // pop ls1b of the current piece bitboard copy
+        pop_bit(bitboard, source_square);
+    }
+}
+
+// generate legal moves only
+static inline void generate_legal_moves(position *pos, moves *move_list)
+{
+    // generate captures & quiet moves with generator specialized for the side to move
+    if (pos->side == white)
+        generate_legal(pos, move_list, all_moves, white);
+
+    else
+        generate_legal(pos, move_list, all_moves, black);
+}
+
+// generate legal captures, enpassant captures & promotions only
+static inline void generate_legal_captures(position *pos, moves *move_list)
+{
+    // generate captures & promotions with generator specialized for the side to move
+    if (pos->side == white)
+        generate_legal(pos, move_list, only_captures, white);
+
+    else
+        generate_legal(pos, move_list, only_captures, black);
+}
+
+/**********************************\
+ ==================================
+
+           Move validation
+
+ ==================================
+\**********************************/
+
+/*
+    Moves taken from the transposition table or killer slots were
+    generated in some other position, so they have to be validated
+    before being made. is_pseudo_legal accepts exactly the moves the
+    pseudo legal generator would produce for the side to move and
+    is_legal then rejects those leaving the own king in check, both
+    working straight off the board without generating a move list.
+*/
+
+// is move one of the pseudo legal moves of the side to move
+static inline int is_pseudo_legal(position *pos, int move)
+{
+    // parse move
+    int source_square = get_move_source(move);
+    int target_square = get_move_target(move);
+    int flags = get_move_flags(move);
+
+    // init side to move & it's piece offset
+    int side = pos->side;
+    int our = (side == white) ? P : p;
+
+    // init moving piece & board occupancy
+    int piece = pos->piece_on[source_square];
+    U64 occupancy = pos->occupancies[both];
+
+    // source square must hold a piece of the side to move
+    if (!get_bit(pos->occupancies[side], source_square))
+        return 0;
+
+    // target square can't hold own piece (rejects empty move as well)
+    if (get_bit(pos->occupancies[side], target_square))
+        return 0;
+
+    // capture flag must be set exactly when there's an enemy piece on target square (enpassant aside)
+    if (flags != enpassant_flag && !get_move_capture(move) != !get_bit(pos->occupancies[side ^ 1], target_square))
+        return 0;
+
+    // castling moves
+    if (flags == castling_flag)
+    {
+        // only the king on it's initial square castles
+        if (piece != our + K || source_square != ((side == white) ? e1 : e8))
+            return 0;
+
+        // white king side castling
+        if (side == white && target_square == g1)
+            return (pos->castle & wk) && !get_bit(occupancy, f1) && !get_bit(occupancy, g1) &&
+                   !is_square_attacked(pos, e1, black) && !is_square_attacked(pos, f1, black);
+
+        // white queen side castling
+        if (side == white && target_square == c1)
+            return (pos->castle & wq) && !get_bit(occupancy, d1) && !get_bit(occupancy, c1) && !get_bit(occupancy, b1) &&
+                   !is_square_attacked(pos, e1, black) && !is_square_attacked(pos, d1, black);
+
+        // black king side castling
+        if (side == black && target_square == g8)
+            return (pos->castle & bk) && !get_bit(occupancy, f8) && !get_bit(occupancy, g8) &&
+                   !is_square_attacked(pos, e8, white) && !is_square_attacked(pos, f8, white);
+
+        // black queen side castling
+        if (side == black && target_square == c8)
+            return (pos->castle & bq) && !get_bit(occupancy, d8) && !get_bit(occupancy, c8) && !get_bit(occupancy, b8) &&
+                   !is_square_attacked(pos, e8, white) && !is_square_attacked(pos, d8, white);
+
+        // no other castling targets
+        return 0;
+    }
+
+    // enpassant captures
+    if (flags == enpassant_flag)
+        return piece == our + P && target_square == pos->enpassant &&
+               get_bit(pawn_attacks[side][source_square], target_square) != 0;
+
+    // pawn moves
+    if (piece == our + P)
+    {
+        // init push direction
+        int push = (side == white) ? -8 : 8;
+
+        // pawn moves onto the promotion rank have to promote, no other pawn moves can
+        if (!get_move_promotion(move) != !get_bit((side == white) ? rank_8 : rank_1, target_square))
+            return 0;
+
+        // double pawn push over an empty square from pawn's initial rank
+        if (flags == double_push_flag)
+            return target_square == source_square + 2 * push && !get_bit(occupancy, source_square + push) &&
+                   get_bit((side == white) ? rank_4 : rank_5, target_square) != 0;
+
+        // remaining pawn moves are pushes & captures (promoting or not)
+        if (!get_move_promotion(move) && flags != quiet_flag && flags != capture_flag)
+            return 0;
+
+        // pawn captures
+        if (get_move_capture(move))
+            return get_bit(pawn_attacks[side][source_square], target_square) != 0;
+
+        // single pawn push (target square is known to be empty)
+        return target_square == source_square + push;
+    }
+
+    // pieces make quiet moves & captures only
+    if (flags != quiet_flag && flags != capture_flag)
+        return 0;
+
+    // init attacks of the moving piece
+    U64 attacks;
+
+    // knight
+    if (piece == our + N)
+        attacks = knight_attacks[source_square];
+
+    // bishop
+    else if (piece == our + B)
+        attacks = get_bishop_attacks(source_square, occupancy);
+
+    // rook
+    else if (piece == our + R)
+        attacks = get_rook_attacks(source_square, occupancy);
+
+    // queen
+    else if (piece == our + Q)
+        attacks = get_queen_attacks(source_square, occupancy);
+
+    // king
+    else
+        attacks = king_attacks[source_square];
+
+    // target square must be attacked by the moving piece
+    return get_bit(attacks, target_square) != 0;
+}
+
+// does pseudo legal move leave the own king out of check
+static inline int is_legal(position *pos, int move)
+{
+    // parse move
+    int source_square = get_move_source(move);
+    int target_square = get_move_target(move);
+
+    // init side to move
+    int side = pos->side;
+
+    // castling king passes safe squares only, it's target square is left to check
+    if (get_move_castling(move))
+        return !is_square_attacked(pos, target_square, side ^ 1);
+
+    // init king square after the move
+    int king_square = get_ls1b_index(pos->bitboards[(side == white) ? K : k]);
+    if (king_square == source_square)
+        king_square = target_square;
+
+    // init square of the piece removed by the move (pawn behind target square on enpassant)
+    U64 captured = 1ULL << target_square;
+    if (get_move_enpassant(move))
+        captured = 1ULL << (target_square + ((side == white) ? 8 : -8));
+
+    // board occupancy after the move
+    U64 occupancy = (pos->occupancies[both] ^ (1ULL << source_square) ^ captured) | (1ULL << target_square);
+
+    // no enemy piece left on board may attack the king
+    return !(attackers_to(pos, king_square, occupancy) & pos->occupancies[side ^ 1] & ~captured);
+}
+
+/**********************************\
+ ==================================
+
+      Static exchange evaluation
+
+ ==================================
+\**********************************/
+
+/*
+    Static exchange evaluation plays out all captures on the target square
+    of a move, both sides always recapturing with their least valuable
+    attacker, and returns the material balance for the side making the
+    move. Sliders hidden behind capturing pieces (x-rays) join in as the
+    board occupancy gets cleared. Pins are not taken into account.
+*/
+
+// piece values used by static exchange evaluation [piece]
+const int see_values[13] = {
+    100, 300, 300, 500, 900, 10000,
+    100, 300, 300, 500, 900, 10000,
+    0
+};
+
+// init material gained by the first capture of the move & the value left on target square
+static inline int see_capture_value(position *pos, int move, int *target_value)
+{
+    // init captured piece value (enpassant captures a pawn off the target square)
+    int captured_value = get_move_enpassant(move) ? see_values[P] : see_values[pos->piece_on[get_move_target(move)]];
+
+    // init piece ending up on target square
+    int piece = get_move_promotion(move) ? get_move_promoted(move, pos->side) : pos->piece_on[get_move_source(move)];
+
+    // promotion gains the difference between promoted piece & pawn
+    if (get_move_promotion(move))
+        captured_value += see_values[piece] - see_values[P];
+
+    // value left on target square to be captured back
+    *target_value = see_values[piece];
+
+    // return material gained by the move itself
+    return captured_value;
+}
+
+// init board occupancy right after the move is made
+static inline U64 see_occupancy(position *pos, int move)
+{
+    // remove moving piece from its source square
+    U64 occupancy = pos->occupancies[both] ^ (1ULL << get_move_source(move));
+
+    // remove pawn captured enpassant
+    if (get_move_enpassant(move))
+        occupancy ^= 1ULL << (get_move_target(move) + ((pos->side == white) ? 8 : -8));
+
+    // put moving piece on target square
+    return occupancy | (1ULL << get_move_target(move));
+}
+
+// get least valuable attacker of a given side among attackers (returns piece & square)
+static inline int see_least_valuable(position *pos, U64 attackers, int side, int *square)
+{
+    // loop over piece types from pawn to king
+    for (int piece = side * 6 + P; piece <= side * 6 + K; piece++)
+    {
+        // attackers of current piece type
+        U64 bitboard = attackers & pos->bitboards[piece];
+
+        // least valuable attacker found
+        if (bitboard)
+        {
+            *square = get_ls1b_index(bitboard);
+            return piece;
+        }
+    }
+
+    // no attackers left
+    return no_piece;
+}
+
+// add sliders attacking target square through the square just cleared (x-rays)
+static inline U64 see_xrays(position *pos, int target_square, int piece, U64 occupancy)
+{
+    // init x-ray attackers
+    U64 xrays = 0ULL;
+
+    // pawns, bishops & queens uncover diagonal sliders
+    if (piece % 6 == P || piece % 6 == B || piece % 6 == Q)
+        xrays |= get_bishop_attacks(target_square, occupancy) &
+                 (pos->bitboards[B] | pos->bitboards[Q] | pos->bitboards[b] | pos->bitboards[q]);
+
+    // rooks & queens uncover orthogonal sliders
+    if (piece % 6 == R || piece % 6 == Q)
+        xrays |= get_rook_attacks(target_square, occupancy) &
+                 (pos->bitboards[R] | pos->bitboards[Q] | pos->bitboards[r] | pos->bitboards[q]);
+
+    // return x-ray attackers
+    return xrays;
+}
+
+// static exchange evaluation of a move (material balance for the side making it)
+static inline int see(position *pos, int move)
+{
+    // material balance after every capture in the sequence
+    int gain[32];
+
+    // init target square
+    int target_square = get_move_target(move);
+
+    // init value of piece standing on target square
+    int target_value;
+
+    // material gained by the move itself
+    gain[0] = see_capture_value(pos, move, &target_value);
+
+    // init board occupancy after the move
+    U64 occupancy = see_occupancy(pos, move);
+
+    // init attackers of both sides still on board
+    U64 attackers = attackers_to(pos, target_square, occupancy) & occupancy;
+
+    // opponent captures back first
+    int side = pos->side ^ 1;
+
+    // capture sequence depth
+    int depth = 0;
+
+    // play out the capture sequence
+    while (depth < 31)
+    {
+        // init least valuable attacker & its square
+        int square;
+        int piece = see_least_valuable(pos, attackers & pos->occupancies[side], side, &square);
+
+        // no more captures
+        if (piece == no_piece)
+            break;
+
+        // speculative balance if current side captures
+        depth++;
+        gain[depth] = target_value - gain[depth - 1];
+
+        // capturing piece is the one standing on target square now
+        target_value = see_values[piece];
+
+        // remove capturing piece from the board & uncover x-ray attackers
+        occupancy ^= 1ULL << square;
+        attackers = (attackers | see_xrays(pos, target_square, piece, occupancy)) & occupancy;
+
+        // switch side
+        side ^= 1;
+    }
+
+    // every side may stop capturing whenever continuing loses material
+    while (depth)
+    {
+        depth--;
+        gain[depth] = -((-gain[depth] > gain[depth + 1]) ? -gain[depth] : gain[depth + 1]);
+    }
+
+    // return material balance of the move
+    return gain[0];
+}
+
+// does static exchange evaluation of a move reach a given margin (cheaper than see)
+static inline int see_ge(position *pos, int move, int margin)
+{
+    // init target square
+    int target_square = get_move_target(move);
+
+    // init value of piece standing on target square
+    int target_value;
+
+    // material short of the margin if opponent doesn't capture back
+    int swap = see_capture_value(pos, move, &target_value) - margin;
+
+    // even the move itself doesn't reach the margin
+    if (swap < 0)
+        return 0;
+
+    // material opponent needs to win back to get under the margin
+    swap = target_value - swap;
+
+    // losing the moving piece still reaches the margin
+    if (swap <= 0)
+        return 1;
+
+    // init board occupancy after the move
+    U64 occupancy = see_occupancy(pos, move);
+
+    // init attackers of both sides still on board
+    U64 attackers = attackers_to(pos, target_square, occupancy) & occupancy;
+
+    // opponent captures back first
+    int side = pos->side ^ 1;
+
+    // result for the side making the move if nobody else captures
+    int result = 1;
+
+    // play out the capture sequence
+    while (1)
+    {
+        // init least valuable attacker & its square
+        int square;
+        int piece = see_least_valuable(pos, attackers & pos->occupancies[side], side, &square);
+
+        // no more captures
+        if (piece == no_piece)
+            break;
+
+        // current side captures
+        result ^= 1;
+
+        // king can only capture when the other side has no attackers left
+        if (piece % 6 == K)
+            return (attackers & pos->occupancies[side ^ 1]) ? result ^ 1 : result;
+
+        // material the other side needs to win back after this capture
+        swap = see_values[piece] - swap;
+
+        // other side can't win enough material back
+        if (swap < result)
+            break;
+
+        // remove capturing piece from the board & uncover x-ray attackers
+        occupancy ^= 1ULL << square;
+        attackers = (attackers | see_xrays(pos, target_square, piece, occupancy)) & occupancy;
+
+        // switch side
+        side ^= 1;
+    }
+
+    // return whether the margin is reached
+    return result;
+}
+
+/**********************************\
+ ==================================
+
+             Evaluation
+
+ ==================================
+\**********************************/
+
+// material score [piece]
+const int material_score[12] = {
+    100, 300, 350, 500, 1000, 10000,
+    -100, -300, -350, -500, -1000, -10000
+};
+
+// pawn positional score
+const int pawn_score[64] = {
+    90,  90,  90,  90,  90,  90,  90,  90,
+    30,  30,  30,  40,  40,  30,  30,  30,
+    20,  20,  20,  30,  30,  30,  20,  20,
+    10,  10,  10,  20,  20,  10,  10,  10,
+     5,   5,  10,  20,  20,   5,   5,   5,
+     0,   0,   0,   5,   5,   0,   0,   0,
+     0,   0,   0, -10, -10,   0,   0,   0,
+     0,   0,   0,   0,   0,   0,   0,   0
+};
+
+// knight positional score
+const int knight_score[64] = {
+    -5,   0,   0,   0,   0,   0,   0,  -5,
+    -5,   0,   0,  10,  10,   0,   0,  -5,
+    -5,   5,  20,  20,  20,  20,   5,  -5,
+    -5,  10,  20,  30,  30,  20,  10,  -5,
+    -5,  10,  20,  30,  30,  20,  10,  -5,
+    -5,   5,  20,  10,  10,  20,   5,  -5,
+    -5,   0,   0,   0,   0,   0,   0,  -5,
+    -5, -10,   0,   0,   0,   0, -10,  -5
+};
+
+// bishop positional score
+const int bishop_score[64] = {
+     0,   0,   0,   0,   0,   0,   0,   0,
+     0,   0,   0,   0,   0,   0,   0,   0,
+     0,   0,   0,  10,  10,   0,   0,   0,
+     0,   0,  10,  20,  20,  10,   0,   0,
+     0,   0,  10,  20,  20,  10,   0,   0,
+     0,  10,   0,   0,   0,   0,  10,   0,
+     0,  30,   0,   0,   0,   0,  30,   0,
+     0,   0, -10,   0,   0, -10,   0,   0
+};
+
+// rook positional score
+const int rook_score[64] = {
+    50,  50,  50,  50,  50,  50,  50,  50,
+    50,  50,  50,  50,  50,  50,  50,  50,
+     0,   0,  10,  20,  20,  10,   0,   0,
+     0,   0,  10,  20,  20,  10,   0,   0,
+     0,   0,  10,  20,  20,  10,   0,   0,
+     0,   0,  10,  20,  20,  10,   0,   0,
+     0,   0,  10,  20,  20,  10,   0,   0,
+     0,   0,   0,  20,  20,   0,   0,   0
+};
+
+// queen positional score
+const int queen_score[64] = {
+     0,   0,   0,   0,   0,   0,   0,   0,
+     0,   0,   0,   0,   0,   0,   0,   0,
+     0,   0,   5,   5,   5,   5,   0,   0,
+     0,   0,   5,  10,  10,   5,   0,   0,
+     0,   0,   5,  10,  10,   5,   0,   0,
+     0,   0,   5,   5,   5,   5,   0,   0,
+     0,   0,   0,   0,   0,   0,   0,   0,
+     0,   0,   0,  -5,   0,   0,   0,   0
+};
+
+// king positional score
+const int king_score[64] = {
+     0,   0,   0,   0,   0,   0,   0,   0,
+     0,   0,   5,   5,   5,   5,   0,   0,
+     0,   5,   5,  10,  10,   5,   5,   0,
+     0,   5,  10,  20,  20,  10,   5,   0,
+     0,   5,  10,  20,  20,  10,   5,   0,
+     0,   0,   5,  10,  10,   5,   0,   0,
+     0,   5,   5,  -5,  -5,   0,   5,   0,
+     0,   0,   5,   0, -15,   0,  10,   0
+};
+
+// positional score tables from white's point of view [piece]
+const int *positional_score[6] = {
+    pawn_score, knight_score, bishop_score, rook_score, queen_score, king_score
+};
+
+// evaluate position from the side to move's point of view
+static inline int evaluate(position *pos)
+{
+    // static evaluation score
+    int score = 0;
+
+    // define current piece's bitboard copy & square
+    U64 bitboard;
+    int square;
+
+    // loop over piece bitboards
+    for (int piece = P; piece <= k; piece++)
+    {
+        // init piece bitboard copy
+        bitboard = pos->bitboards[piece];
+
+        // loop over pieces within a bitboard
+        while (bitboard)
+        {
+            // init square
+            square = get_ls1b_index(bitboard);
+
+            // score material weights
+            score += material_score[piece];
+
+            // score positional piece scores (black pieces use vertically mirrored squares)
+            if (piece <= K)
+                score += positional_score[piece][square];
+
+            else
+                score -= positional_score[piece - p][square ^ 56];
+
+            // pop ls1b
+            pop_bit(bitboard, square);
+        }
+    }
+
+    // return final evaluation based on side
+    return (pos->side == white) ? score : -score;
+}
+
+// score bounds
+#define infinity 32000
+#define mate_value 31000
+#define mate_score 30000
+
+/**********************************\
+ ==================================
+
+        Transposition table
+
+ ==================================
+\**********************************/
+
+/*
+    Transposition table stores search results keyed on the position's
+    hash key. Four 16 byte entries share a 64 byte bucket, so a probe
+    touches a single cache line, and the bucket of a child position is
+    prefetched as soon as the move leading to it has been made. Searching
+    threads share the table without locks: entries are verified the same
+    way as perft hash entries, with the key stored XORed with the data.
+
+    A new result replaces the entry holding the same position, otherwise
+    the entry with the lowest depth, entries left over from previous
+    searches counting as 8 plies shallower per search they are old.
+
+                    tt entry data bits
+
+          bits  0-15    best move
+          bits 16-31    score (signed)
+          bits 32-39    depth
+          bits 40-41    hash flag
+          bits 42-47    age (search counter)
+*/
+
+// scores are packed into 16 signed bits of transposition table entry data
+_Static_assert(infinity <= 32767, "search scores don't fit into transposition table entries");
+
+// hash flags
+enum
+{
+    hash_flag_exact,
+    hash_flag_alpha,
+    hash_flag_beta
+};
+
+// no hash entry found constant
+#define no_hash_entry 100000
+
+// number of entries per bucket
+#define tt_bucket_entries 4
+
+// default transposition table size in megabytes
+#define default_hash_mb 64
+
+// transposition table entry
+typedef struct
+{
+    // position hash key XOR data
+    U64 hash_key;
+
+    // best move, score, depth, hash flag & age
+    U64 data;
+} tt_entry;
+
+// transposition table bucket (one cache line)
+typedef struct
+{
+    _Alignas(64) tt_entry entries[tt_bucket_entries];
+} tt_bucket;
+
+// aligned_alloc needs table size to be a multiple of the alignment
+_Static_assert(sizeof(tt_bucket) == 64, "transposition table bucket doesn't fill a cache line");
+
+// transposition table (disabled when NULL)
+tt_bucket *hash_table = NULL;
+
+// number of buckets in transposition table
+U64 hash_buckets = 0;
+
+// age of the entries written by current search
+int hash_age = 0;
+
+// extract transposition table entry fields
+#define get_tt_move(data) ((int)((data) & 0xffff))
+#define get_tt_score(data) ((int)(short)(((data) >> 16) & 0xffff))
+#define get_tt_depth(data) ((int)(((data) >> 32) & 0xff))
+#define get_tt_flag(data) ((int)(((data) >> 40) & 0x3))
+#define get_tt_age(data) ((int)(((data) >> 42) & 0x3f))
+
+// clear transposition table
+void clear_hash_table()
+{
+    // reset all buckets
+    if (hash_table)
+        memset(hash_table, 0, hash_buckets * sizeof(tt_bucket));
+
+    // reset age
+    hash_age = 0;
+}
+
+// allocate transposition table of a given size in megabytes
+void init_hash_table(int mb)
+{
+    // new table
+    tt_bucket *table = NULL;
+
+    // halve the size until the table fits into memory
+    for (; mb >= 1; mb /= 2)
+    {
+        // allocate cache line aligned memory for the table
+#ifdef WIN64
+        table = _aligned_malloc((U64)mb * 0x100000, 64);
+#else
+        table = aligned_alloc(64, (U64)mb * 0x100000);
+#endif
+
+        // allocation succeeded
+        if (table)
+            break;
+
+        printf("  Couldn't allocate %d MB for transposition table!\n", mb);
+    }
+
+    // keep previous table if not even 1 MB could be allocated
+    if (table == NULL)
+        return;
+
+    // free previously allocated table
+#ifdef WIN64
+    _aligned_free(hash_table);
+#else
+    free(hash_table);
+#endif
+
+    // init table & number of buckets
+    hash_table = table;
+    hash_buckets = ((U64)mb * 0x100000) / sizeof(tt_bucket);
+
+    // clear the table
+    clear_hash_table();
+}
+
+// prefetch transposition table bucket of a given hash key
+static inline void prefetch_hash_entry(U64 hash_key)
+{
+    // bring the bucket into cache while the caller is busy with other things
+    if (hash_table)
+        __builtin_prefetch(&hash_table[hash_key % hash_buckets]);
+}
+
+// read hash entry data (score is no_hash_entry unless it's good enough to cut the node off)
+static inline int read_hash_entry(U64 hash_key, int alpha, int beta, int depth, int ply, int *move)
+{
+    // no hash move by default
+    *move = 0;
+
+    // transposition table disabled
+    if (hash_table == NULL)
+        return no_hash_entry;
+
+    // init bucket
+    tt_bucket *bucket = &hash_table[hash_key % hash_buckets];
+
+    // loop over bucket entries
+    for (int index = 0; index < tt_bucket_entries; index++)
+    {
+        // read entry data once (other threads may be writing it)
+        U64 data = bucket->entries[index].data;
+
+        // make sure we're dealing with the exact position
+        if ((bucket->entries[index].hash_key ^ data) != hash_key)
+            continue;
+
+        // hash move is good for move ordering regardless of depth
+        *move = get_tt_move(data);
+
+        // stored result comes from a shallower search
+        if (get_tt_depth(data) < depth)
+            return no_hash_entry;
+
+        // init score (mate scores are stored relative to the node)
+        int score = get_tt_score(data);
+        if (score < -mate_score) score += ply;
+        if (score > mate_score) score -= ply;
+
+        // match the exact (PV node) score
+        if (get_tt_flag(data) == hash_flag_exact)
+            return score;
+
+        // match alpha (fail-low node) score
+        if (get_tt_flag(data) == hash_flag_alpha && score <= alpha)
+            return alpha;
+
+        // match beta (fail-high node) score
+        if (get_tt_flag(data) == hash_flag_beta && score >= beta)
+            return beta;
+
+        // bound doesn't cut the node off
+        return no_hash_entry;
+    }
+
+    // entry not found
+    return no_hash_entry;
+}
+
+// write hash entry data
+static inline void write_hash_entry(U64 hash_key, int score, int depth, int ply, int move, int hash_flag)
+{
+    // transposition table disabled
+    if (hash_table == NULL)
+        return;
+
+    // init bucket
+    tt_bucket *bucket = &hash_table[hash_key % hash_buckets];
+
+    // init entry to replace & it's replacement value
+    tt_entry *replace = &bucket->entries[0];
+    int replace_value = infinity;
+
+    // loop over bucket entries
+    for (int index = 0; index < tt_bucket_entries; index++)
+    {
+        // read entry data once (other threads may be writing it)
+        U64 data = bucket->entries[index].data;
+
+        // same position is always overwritten
+        if ((bucket->entries[index].hash_key ^ data) == hash_key)
+        {
+            // keep hash move of the previous search if there's no new one
+            if (!move)
+                move = get_tt_move(data);
+
+            replace = &bucket->entries[index];
+            break;
+        }
+
+        // entries from previous searches count as shallower ones
+        int value = get_tt_depth(data) - 8 * ((hash_age - get_tt_age(data)) & 0x3f);
+
+        // pick the least valuable entry
+        if (value < replace_value)
+        {
+            replace = &bucket->entries[index];
+            replace_value = value;
+        }
+    }
+
+    // store mate scores relative to the node
+    if (score < -mate_score) score -= ply;
+    if (score > mate_score) score += ply;
+
+    // init entry data
+    U64 data = (U64)(move & 0xffff) |
+               ((U64)(score & 0xffff) << 16) |
+               ((U64)(depth & 0xff) << 32) |
+               ((U64)hash_flag << 40) |
+               ((U64)hash_age << 42);
+
+    // store position & search result
+    replace->hash_key = hash_key ^ data;
+    replace->data = data;
+}
+
+/**********************************\
+ ==================================
+
+            Move ordering
+
+ ==================================
+\**********************************/
+
+/*
+    Captures are ordered by MVV LVA (most valuable victim, least valuable
+    attacker). Promotions score as if the pawn captured the promoted
+    piece, so queen promotions go first and underpromotions last.
+
+    (Victims) Pawn Knight Bishop   Rook  Queen   King
+  (Attackers)
+        Pawn   105    205    305    405    505    605
+      Knight   104    204    304    404    504    604
+      Bishop   103    203    303    403    503    603
+        Rook   102    202    302    402    502    602
+       Queen   101    201    301    401    501    601
+        King   100    200    300    400    500    600
+*/
+
+// MVV LVA [attacker][victim]
+const int mvv_lva[6][6] = {
+    {105, 205, 305, 405, 505, 605},
+    {104, 204, 304, 404, 504, 604},
+    {103, 203, 303, 403, 503, 603},
+    {102, 202, 302, 402, 502, 602},
+    {101, 201, 301, 401, 501, 601},
+    {100, 200, 300, 400, 500, 600}
+};
+
+// score capture or promotion for move ordering
+static inline int score_capture(position *pos, int move)
+{
+    // init score
+    int score = 0;
+
+    // init attacker (piece types of both sides share MVV LVA rows & columns)
+    int attacker = pos->piece_on[get_move_source(move)] % 6;
+
+    // score capture (enpassant captures a pawn off the target square)
+    if (get_move_capture(move))
+        score += mvv_lva[attacker][get_move_enpassant(move) ? P : pos->piece_on[get_move_target(move)] % 6];
+
+    // score promotion as capturing the promoted piece by a pawn
+    if (get_move_promotion(move))
+        score += mvv_lva[P][get_move_promoted(move, white)];
+
+    // return move score
+    return score;
+}
+
+// score captures & promotions within a move list
+static inline void score_captures(position *pos, moves *move_list)
+{
+    // loop over moves within a move list
+    for (int count = 0; count < move_list->count; count++)
+        // score move
+        move_list->scores[count] = score_capture(pos, move_list->moves[count]);
+}
+
+// bring the best scored move of the remaining ones to a given index (selection sort step)
+static inline void pick_move(moves *move_list, int index)
+{
+    // init best move index
+    int best = index;
+
+    // loop over remaining moves
+    for (int count = index + 1; count < move_list->count; count++)
+        // found better scored move
+        if (move_list->scores[count] > move_list->scores[best])
+            best = count;
+
+    // swap best move with the move at given index
+    if (best != index)
+    {
+        U16 move = move_list->moves[index];
+        int score = move_list->scores[index];
+
+        move_list->moves[index] = move_list->moves[best];
+        move_list->scores[index] = move_list->scores[best];
+
+        move_list->moves[best] = move;
+        move_list->scores[best] = score;
+    }
+}
+
+/**********************************\
+ ==================================
+
+               Search
+
+ ==================================
+\**********************************/
+
+/*
+    Negamax alpha-beta search is run by iterative deepening: every
+    iteration searches the moves of the previous principal variation
+    first, and only a completed iteration updates the best move, so a
+    search interrupted by the clock or by the GUI still plays the best
+    move found one ply shallower. GUI input and the clock are polled
+    every communicate_interval nodes.
+
+    Principal variation search: only the first move of a node gets the
+    full window, the rest are searched with a null window around alpha
+    and re-searched only if they turn out to be better. Null window
+    nodes are the ones cut off by transposition table entries.
+*/
+
+// maximum search depth in plies
+#define max_ply 64
+
+// number of nodes searched in between GUI input & clock polls (power of 2)
+#define communicate_interval 2048
+
+// search state
+typedef struct
+{
+    // board being searched
+    position pos;
+
+    // nodes visited
+    U64 nodes;
+
+    // previous iteration's principal variation is being followed
+    int follow_pv;
+
+    // principal variation length [ply]
+    int pv_length[max_ply];
+
+    // principal variation table [ply][ply]
+    U16 pv_table[max_ply][max_ply];
+
+    // principal variation of the last completed iteration
+    int best_line_length;
+    U16 best_line[max_ply];
+
+    // depth & score of the last completed iteration
+    int completed_depth;
+    int best_score;
+
+    // search thread index (0 for the main thread)
+    int thread_id;
+
+    // break move ordering ties in reverse generation order
+    int reverse_order;
+
+    // killer moves [id][ply]
+    U16 killer_moves[2][max_ply];
+
+    // history moves [side][source square][target square]
+    int history_moves[2][64][64];
+
+    // beta cutoffs & the ones produced by the first move searched
+    U64 beta_cutoffs;
+    U64 first_move_cutoffs;
+
+    // nodes cut off by transposition table entries
+    U64 hash_cutoffs;
+} search_data;
+
+/*
+    Lazy SMP: every search thread runs it's own iterative deepening on a
+    private copy of the board and all of them share the transposition
+    table, which is where helper threads pay off by filling it with
+    results the main thread picks up. Helper threads skip some of the
+    iterations following fixed size & phase patterns and every other
+    helper breaks move ordering ties in reverse generation order, so
+    threads don't walk the same tree in lockstep. The main thread alone polls GUI input
+    and the clock, and once it's done the move of the deepest completed
+    iteration among all threads is played.
+*/
+
+// maximum number of search threads
+#define max_search_threads 256
+
+// number of search threads
+int search_threads = 1;
+
+// search states of all search threads [thread]
+search_data *search_states = NULL;
+
+// maximum depth of current search
+int search_depth;
+
+// print UCI info lines & best move while searching
+int search_verbose = 1;
+
+// allocate search states of a given number of threads
+void init_search_threads(int count)
+{
+    // keep number of threads within bounds
+    if (count < 1) count = 1;
+    if (count > max_search_threads) count = max_search_threads;
+
+    // new states
+    search_data *states = NULL;
+
+    // halve the number of threads until their states fit into memory
+    for (; count >= 1; count /= 2)
+    {
+        // allocate cache line aligned states
+#ifdef WIN64
+        states = _aligned_malloc(count * sizeof(search_data), 64);
+#else
+        states = aligned_alloc(64, count * sizeof(search_data));
+#endif
+
+        // allocation succeeded
+        if (states)
+            break;
+
+        printf("  Couldn't allocate search states of %d threads!\n", count);
+    }
+
+    // keep previous states if not even a single thread's state could be allocated
+    if (states == NULL)
+    {
+        // engine can't search without any state
+        if (search_states == NULL)
+            exit(1);
+
+        // clear previous states
+        memset(search_states, 0, search_threads * sizeof(search_data));
+        return;
+    }
+
+    // free previously allocated states
+#ifdef WIN64
+    _aligned_free(search_states);
+#else
+    free(search_states);
+#endif
+
+    // start with empty killer & history tables
+    search_states = states;
+    memset(search_states, 0, count * sizeof(search_data));
+
+    // init number of search threads
+    search_threads = count;
+}
+
+// share of beta cutoffs produced by the first move searched in all search threads (percent)
+double first_move_cutoff_rate()
+{
+    // init beta cutoffs
+    U64 beta_cutoffs = 0, first_move_cutoffs = 0;
+
+    // sum up beta cutoffs of all search threads
+    for (int thread = 0; thread < search_threads; thread++)
+    {
+        beta_cutoffs += search_states[thread].beta_cutoffs;
+        first_move_cutoffs += search_states[thread].first_move_cutoffs;
+    }
+
+    // return first move cutoff rate
+    return beta_cutoffs ? 100.0 * first_move_cutoffs / beta_cutoffs : 0.0;
+}
+
+// nodes visited by all search threads
+U64 total_search_nodes()
+{
+    // init nodes
+    U64 nodes = 0;
+
+    // sum up nodes of all search threads
+    for (int thread = 0; thread < search_threads; thread++)
+        nodes += search_states[thread].nodes;
+
+    // return nodes
+    return nodes;
+}
+
+// is current position a repetition of an earlier one
+static inline int is_repetition(position *pos)
+{
+    // loop over positions reached before
+    for (int index = 0; index < pos->repetition_index; index++)
+        // position has been seen before
+        if (pos->repetition_table[index] == pos->hash_key)
+            return 1;
+
+    // no repetition found
+    return 0;
+}
+
+/*
+    Generated moves are searched in score order: captures & promotions
+    (MVV LVA) first, then the two killer moves of the ply (quiet moves
+    that caused a beta cutoff in a sibling node), then the rest of quiet
+    moves by their history score. A quiet move causing a beta cutoff
+    gets a history bonus, quiet moves searched before it get a malus of
+    the same size. Updates are gravity-style: the closer a score gets to
+    max_history the smaller the step, so history scores saturate within
+    +/- max_history instead of overflowing.
+*/
+
+// move ordering scores of captures & killer moves (above any history score)
+#define capture_score 20000
+#define first_killer_score 19000
+#define second_killer_score 18000
+
+// maximum absolute history score
+#define max_history 16384
+
+// update history score of a move with the gravity formula
+static inline void update_history(search_data *data, int move, int bonus)
+{
+    // init history entry
+    int *history = &data->history_moves[data->pos.side][get_move_source(move)][get_move_target(move)];
+
+    // move score towards +/- max_history
+    *history += bonus - *history * abs(bonus) / max_history;
+}
+
+// score generated moves for move ordering
+static inline void score_moves(search_data *data, moves *move_list)
+{
+    // init position & ply
+    position *pos = &data->pos;
+    int ply = pos->ply;
+
+    // reverse generation order (breaks score ties the other way round)
+    if (data->reverse_order)
+    {
+        for (int count = 0; count < move_list->count / 2; count++)
+        {
+            U16 move = move_list->moves[count];
+            move_list->moves[count] = move_list->moves[move_list->count - 1 - count];
+            move_list->moves[move_list->count - 1 - count] = move;
+        }
+    }
+
+    // loop over moves within a move list
+    for (int count = 0; count < move_list->count; count++)
+    {
+        // init move
+        int move = move_list->moves[count];
+
+        // score captures & promotions
+        if (get_move_capture(move) || get_move_promotion(move))
+            move_list->scores[count] = capture_score + score_capture(pos, move);
+
+        // score 1st killer move
+        else if (move == data->killer_moves[0][ply])
+            move_list->scores[count] = first_killer_score;
+
+        // score 2nd killer move
+        else if (move == data->killer_moves[1][ply])
+            move_list->scores[count] = second_killer_score;
+
+        // score history move
+        else
+            move_list->scores[count] = data->history_moves[pos->side][get_move_source(move)][get_move_target(move)];
+    }
+}
+
+// score margin on top of captured material below which captures can't raise alpha
+#define delta_margin 200
+
+// material gained by a capture or promotion in evaluation terms (white piece values)
+static inline int delta_gain(position *pos, int move)
+{
+    // init captured material (enpassant captures a pawn off the target square)
+    int gain = get_move_enpassant(move) ? material_score[P] :
+               get_move_capture(move) ? material_score[pos->piece_on[get_move_target(move)] % 6] : 0;
+
+    // promotion gains the difference between promoted piece & pawn
+    if (get_move_promotion(move))
+        gain += material_score[get_move_promoted(move, white)] - material_score[P];
+
+    // return material gained
+    return gain;
+}
+
+// quiescence search (captures & promotions only unless in check)
+static inline int quiescence(search_data *data, int alpha, int beta)
+{
+    // init position & ply
+    position *pos = &data->pos;
+    int ply = pos->ply;
+
+    // main thread listens to GUI input & checks the clock every once in a while
+    if (data->thread_id == 0 && (data->nodes & (communicate_interval - 1)) == 0)
+        communicate();
+
+    // increment nodes count
+    data->nodes++;
+
+    // we are too deep, hence there's an overflow of arrays relying on max ply constant
+    if (ply >= max_ply - 1)
+        return evaluate(pos);
+
+    // is king in check
+    int in_check = is_square_attacked(pos, get_ls1b_index(pos->bitboards[(pos->side == white) ? K : k]), pos->side ^ 1);
+
+    // init static evaluation (side to move may stand pat unless in check)
+    int stand_pat = 0;
+
+    // create move list instance
+    moves move_list[1];
+
+    // in check every evasion has to be searched
+    if (in_check)
+    {
+        // generate legal moves
+        generate_legal_moves(pos, move_list);
+
+        // checkmate
+        if (!move_list->count)
+            return -mate_value + ply;
+    }
+
+    else
+    {
+        // evaluate position
+        stand_pat = evaluate(pos);
+
+        // fail-hard beta cutoff
+        if (stand_pat >= beta)
+            // node (position) fails high
+            return beta;
+
+        // found a better score
+        if (stand_pat > alpha)
+            // PV node (position)
+            alpha = stand_pat;
+
+        // generate legal captures & promotions
+        generate_legal_captures(pos, move_list);
+    }
+
+    // score captures for move ordering
+    score_captures(pos, move_list);
+
+    // loop over moves within a move list
+    for (int count = 0; count < move_list->count; count++)
+    {
+        // bring the best of the remaining moves to front
+        pick_move(move_list, count);
+
+        // init move
+        int move = move_list->moves[count];
+
+        // captures & promotions are pruned unless evading a check
+        if (!in_check)
+        {
+            // delta pruning: even winning the material with a margin doesn't raise alpha
+            if (stand_pat + delta_gain(pos, move) + delta_margin <= alpha)
+                continue;
+
+            // losing captures are skipped
+            if (!see_ge(pos, move, 0))
+                continue;
+        }
+
+        // make move
+        pos->ply++;
+        make_move(pos, move, legal_moves);
+
+        // score current move
+        int score = -quiescence(data, -beta, -alpha);
+
+        // take move back
+        unmake_move(pos, move);
+        pos->ply--;
+
+        // time is up or GUI asked to stop
+        if (stopped)
+            return 0;
+
+        // found a better move
+        if (score > alpha)
+        {
+            // PV node (move)
+            alpha = score;
+
+            // fail-hard beta cutoff
+            if (score >= beta)
+                // node (move) fails high
+                return beta;
+        }
+    }
+
+    // node (move) fails low
+    return alpha;
+}
+
+// negamax alpha beta search
+static inline int negamax(search_data *data, int alpha, int beta, int depth)
+{
+    // init position & ply
+    position *pos = &data->pos;
+    int ply = pos->ply;
+
+    // init principal variation length
+    data->pv_length[ply] = ply;
+
+    // draw by repetition
+    if (ply && is_repetition(pos))
+        return 0;
+
+    // escape condition: resolve captures before evaluating leaf position
+    if (depth <= 0)
+        return quiescence(data, alpha, beta);
+
+    // main thread listens to GUI input & checks the clock every once in a while
+    if (data->thread_id == 0 && (data->nodes & (communicate_interval - 1)) == 0)
+        communicate();
+
+    // increment nodes count
+    data->nodes++;
+
+    // we are too deep, hence there's an overflow of arrays relying on max ply constant
+    if (ply >= max_ply - 1)
+        return evaluate(pos);
+
+    // is node searched with a full window (PV node)
+    int pv_node = beta - alpha > 1;
+
+    // init hash move
+    int hash_move;
+
+    // read hash entry
+    int score = read_hash_entry(pos->hash_key, alpha, beta, depth, ply, &hash_move);
+
+    // hashed result cuts the node off (PV nodes are searched to keep the line intact)
+    if (ply && !pv_node && score != no_hash_entry)
+    {
+        // count hash cutoffs for search statistics
+        data->hash_cutoffs++;
+
+        return score;
+    }
+
+    // is king in check
+    int in_check = is_square_attacked(pos, get_ls1b_index(pos->bitboards[(pos->side == white) ? K : k]), pos->side ^ 1);
+
+    // increase search depth if the king has been exposed into a check
+    if (in_check)
+        depth++;
+
+    // first move is previous iteration's principal variation move while following it, hash move otherwise
+    int first_move = hash_move;
+
+    // following principal variation
+    if (data->follow_pv)
+    {
+        // stop following unless previous principal variation reaches this ply
+        data->follow_pv = 0;
+
+        if (ply < data->best_line_length)
+        {
+            // keep following principal variation in the first move's subtree
+            first_move = data->best_line[ply];
+            data->follow_pv = 1;
+        }
+    }
+
+    // first move comes from another position, make sure it's legal in this one
+    if (first_move && !(is_pseudo_legal(pos, first_move) && is_legal(pos, first_move)))
+    {
+        first_move = 0;
+        data->follow_pv = 0;
+    }
+
+    // create move list instance
+    moves move_list[1];
+    move_list->count = 0;
+
+    // moves are generated only after the first move has failed to cut the node off
+    if (!first_move)
+    {
+        // generate legal moves
+        generate_legal_moves(pos, move_list);
+
+        // no legal moves: checkmate or stalemate
+        if (!move_list->count)
+            return in_check ? -mate_value + ply : 0;
+
+        // score moves for move ordering
+        score_moves(data, move_list);
+    }
+
+    // define hash flag & best move
+    int hash_flag = hash_flag_alpha;
+    int best_move = 0;
+
+    // number of moves searched
+    int moves_searched = 0;
+
+    // quiet moves searched without causing a beta cutoff
+    U16 quiet_moves[256];
+    int quiet_count = 0;
+
+    // loop over the first move (count -1) & the moves within a move list
+    for (int count = first_move ? -1 : 0; count < move_list->count; count++)
+    {
+        // bring the best scored of the remaining moves to front
+        if (count >= 0)
+            pick_move(move_list, count);
+
+        // init move
+        int move = (count < 0) ? first_move : move_list->moves[count];
+
+        // first move has been searched already
+        if (count >= 0 && move == first_move)
+            continue;
+
+        // is move quiet
+        int quiet = !get_move_capture(move) && !get_move_promotion(move);
+
+        // remember position for repetition detection
+        pos->repetition_table[pos->repetition_index++] = pos->hash_key;
+
+        // make move
+        pos->ply++;
+        make_move(pos, move, legal_moves);
+
+        // child position's hash key is known, bring it's bucket into cache
+        prefetch_hash_entry(pos->hash_key);
+
+        // first move is searched with a full window
+        if (moves_searched == 0)
+            score = -negamax(data, -beta, -alpha, depth - 1);
+
+        // principal variation search: prove the rest of the moves are worse with a null window
+        else
+        {
+            score = -negamax(data, -alpha - 1, -alpha, depth - 1);
+
+            // move might be better after all, re-search it with a full window
+            if (score > alpha && score < beta)
+                score = -negamax(data, -beta, -alpha, depth - 1);
+        }
+
+        // take move back
+        unmake_move(pos, move);
+        pos->ply--;
+        pos->repetition_index--;
+
+        // only the first move's subtree may follow principal variation
+        data->follow_pv = 0;
+
+        // time is up or GUI asked to stop
+        if (stopped)
+            return 0;
+
+        // increment searched moves counter
+        moves_searched++;
+
+        // found a better move
+        if (score > alpha)
+        {
+            // switch hash flag from storing score for fail-low node to the one storing score for PV node
+            hash_flag = hash_flag_exact;
+            best_move = move;
+
+            // PV node (move)
+            alpha = score;
+
+            // write PV move & copy move from deeper ply into a current ply's line
+            data->pv_table[ply][ply] = move;
+
+            for (int next_ply = ply + 1; next_ply < data->pv_length[ply + 1]; next_ply++)
+                data->pv_table[ply][next_ply] = data->pv_table[ply + 1][next_ply];
+
+            // adjust PV length
+            data->pv_length[ply] = data->pv_length[ply + 1];
+
+            // fail-hard beta cutoff
+            if (score >= beta)
+            {
+                // count beta cutoffs for move ordering statistics
+                data->beta_cutoffs++;
+
+                if (moves_searched == 1)
+                    data->first_move_cutoffs++;
+
+                // quiet move causing the cutoff
+                if (quiet)
+                {
+                    // store killer moves
+                    if (data->killer_moves[0][ply] != move)
+                    {
+                        data->killer_moves[1][ply] = data->killer_moves[0][ply];
+                        data->killer_moves[0][ply] = move;
+                    }
+
+                    // init history bonus
+                    int bonus = depth * depth * 16 < max_history / 8 ? depth * depth * 16 : max_history / 8;
+
+                    // reward the move & penalize quiet moves searched before it
+                    update_history(data, move, bonus);
+
+                    for (int index = 0; index < quiet_count; index++)
+                        update_history(data, quiet_moves[index], -bonus);
+                }
+
+                // store hash entry with the score equal to beta
+                write_hash_entry(pos->hash_key, beta, depth, ply, move, hash_flag_beta);
+
+                // node (move) fails high
+                return beta;
+            }
+        }
+
+        // remember quiet move that failed to cut the node off
+        if (quiet)
+            quiet_moves[quiet_count++] = move;
+
+        // first move failed to cut the node off, generate & score the rest of the moves
+        if (count < 0)
+        {
+            generate_legal_moves(pos, move_list);
+            score_moves(data, move_list);
+        }
+    }
+
+    // store hash entry with the score equal to alpha
+    write_hash_entry(pos->hash_key, alpha, depth, ply, best_move, hash_flag);
+
+    // node (move) fails low
+    return alpha;
+}
+
+// print UCI info line of a completed iteration
+void print_search_info(search_data *data, int score, int depth)
+{
+    // init elapsed time & nodes visited by all search threads
+    int time = get_time_ms() - starttime;
+    U64 nodes = total_search_nodes();
+
+    // print score (mate scores in moves)
+    if (score > -mate_value && score < -mate_score)
+        printf("info score mate %d", -(score + mate_value) / 2);
+
+    else if (score > mate_score && score < mate_value)
+        printf("info score mate %d", (mate_value - score + 1) / 2);
+
+    else
+        printf("info score cp %d", score);
+
+    // print depth, nodes, time & nodes per second
+    printf(" depth %d nodes %llu time %d nps %llu pv ", depth, nodes, time,
+           time ? nodes * 1000 / time : 0ULL);
+
+    // loop over principal variation moves
+    for (int count = 0; count < data->best_line_length; count++)
+    {
+        // print PV move
+        print_move(data->best_line[count]);
+        printf(" ");
+    }
+
+    // print new line
+    printf("\n");
+
+    // init beta & hash cutoffs of all search threads
+    U64 beta_cutoffs = 0, hash_cutoffs = 0;
+
+    for (int thread = 0; thread < search_threads; thread++)
+    {
+        beta_cutoffs += search_states[thread].beta_cutoffs;
+        hash_cutoffs += search_states[thread].hash_cutoffs;
+    }
+
+    // print move ordering & transposition table statistics
+    printf("info string beta cutoffs %llu first move %.1f%% hash cutoffs %llu\n", beta_cutoffs, first_move_cutoff_rate(), hash_cutoffs);
+}
+
+// iteration skip sizes & phases of helper threads [helper thread index % 20]
+const int skip_size[20] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+const int skip_phase[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+// iterative deepening run by every search thread
+void iterative_deepening(search_data *data)
+{
+    // iterative deepening
+    for (int current_depth = 1; current_depth <= search_depth && current_depth < max_ply; current_depth++)
+    {
+        // helper threads skip some of the iterations so threads search different depths at a time
+        if (data->thread_id)
+        {
+            // init helper thread index
+            int index = (data->thread_id - 1) % 20;
+
+            // skip current iteration
+            if (((current_depth + skip_phase[index]) / skip_size[index]) % 2)
+                continue;
+        }
+
+        // follow previous iteration's principal variation
+        data->follow_pv = 1;
+
+        // find best move within a given position
+        int score = negamax(data, -infinity, infinity, current_depth);
+
+        // interrupted iteration is discarded
+        if (stopped)
+            break;
+
+        // keep result of the completed iteration
+        data->completed_depth = current_depth;
+        data->best_score = score;
+        data->best_line_length = data->pv_length[0];
+        memcpy(data->best_line, data->pv_table[0], data->best_line_length * sizeof(U16));
+
+        // helper threads leave reporting & time management to the main thread
+        if (data->thread_id)
+            continue;
+
+        // print search info
+        if (search_verbose)
+            print_search_info(data, score, current_depth);
+
+        // next iteration would hardly complete within the time left
+        if (timeset && get_time_ms() - starttime > (stoptime - starttime) / 2)
+            break;
+    }
+}
+
+// helper search thread
+void *search_worker(void *arg)
+{
+    // search until the main thread is done
+    iterative_deepening((search_data *)arg);
+
+    return NULL;
+}
+
+// search position for the best move
+int search_position(position *pos, int depth)
+{
+    // entries written from now on are younger than the ones left by previous searches
+    hash_age = (hash_age + 1) & 0x3f;
+
+    // reset search state
+    stopped = 0;
+    search_depth = depth;
+
+    // loop over search threads
+    for (int thread = 0; thread < search_threads; thread++)
+    {
+        // init thread's search state
+        search_data *data = &search_states[thread];
+        data->thread_id = thread;
+        data->reverse_order = thread & 1;
+        data->nodes = 0;
+        data->beta_cutoffs = 0;
+        data->first_move_cutoffs = 0;
+        data->hash_cutoffs = 0;
+        data->completed_depth = 0;
+
+        // killer moves of previous search are of no use (plies have shifted)
+        memset(data->killer_moves, 0, sizeof(data->killer_moves));
+        data->best_line_length = 0;
+
+        // every thread searches a private copy of the board
+        data->pos = *pos;
+        data->pos.ply = 0;
+    }
+
+    // helper threads
+    pthread_t helpers[max_search_threads];
+
+    // number of threads running (main thread included)
+    int started = 1;
+
+    // start helpers
+    for (int thread = 1; thread < search_threads; thread++)
+    {
+        // helper couldn't be created, search with fewer threads
+        if (pthread_create(&helpers[thread], NULL, search_worker, &search_states[thread]))
+            break;
+
+        started++;
+    }
+
+    // main thread searches until depth is reached, time is up or GUI asks to stop
+    iterative_deepening(&search_states[0]);
+
+    // stop helpers & wait for them
+    stopped = 1;
+
+    for (int thread = 1; thread < started; thread++)
+        pthread_join(helpers[thread], NULL);
+
+    // pick the thread that has completed the deepest iteration (main thread wins ties)
+    search_data *best = &search_states[0];
+
+    for (int thread = 1; thread < search_threads; thread++)
+        if (search_states[thread].completed_depth > best->completed_depth)
+            best = &search_states[thread];
+
+    // best move is the first legal one unless an iteration has completed
+    moves move_list[1];
+    generate_legal_moves(pos, move_list);
+    int best_move = move_list->count ? move_list->moves[0] : 0;
+
+    if (best->best_line_length)
+        best_move = best->best_line[0];
+
+    // UCI output is off (benchmark)
+    if (!search_verbose)
+        return best_move;
+
+    // helper thread went deeper than the main thread
+    if (best != &search_states[0])
+        print_search_info(best, best->best_score, best->completed_depth);
+
+    // print best move
+    printf("bestmove ");
+
+    if (best_move)
+        print_move(best_move);
+
+    else
+        printf("0000");
+
+    printf("\n");
+
+    // return best move
+    return best_move;
+}
+
+// positions searched by Lazy SMP benchmark
+char *bench_positions[] = {start_position, tricky_position, killer_position, cmk_position};
+
+// number of positions searched by Lazy SMP benchmark
+#define bench_position_count 4
+
+// time to depth of Lazy SMP search with 1, 2, 4 ... max_threads threads
+void bench_smp(int depth, int max_threads)
+{
+    // init position
+    position pos[1];
+
+    // allocate transposition table
+    if (hash_table == NULL)
+        init_hash_table(default_hash_mb);
+
+    // search without UCI output & time control
+    search_verbose = 0;
+    timeset = 0;
+
+    // init single thread time
+    int single_thread_time = 0;
+
+    printf("\n     Lazy SMP time to depth %d (%d positions)\n\n", depth, bench_position_count);
+    printf("     Threads      Time ms    Speedup          Nodes   First cut   Hash cuts\n");
+
+    // loop over thread counts
+    for (int threads = 1; threads <= max_threads; threads = (threads < max_threads && threads * 2 > max_threads) ? max_threads : threads * 2)
+    {
+        // init search threads
+        init_search_threads(threads);
+
+        // init time, nodes & first move cutoff rate
+        int time = 0;
+        U64 nodes = 0;
+        double first_cut = 0;
+        U64 hash_cuts = 0;
+
+        // loop over positions
+        for (int index = 0; index < bench_position_count; index++)
+        {
+            // search every position from scratch
+            clear_hash_table();
+            parse_fen(pos, bench_positions[index]);
+
+            // time search to depth
+            starttime = get_time_ms();
+            search_position(pos, depth);
+            time += get_time_ms() - starttime;
+            nodes += total_search_nodes();
+            first_cut += first_move_cutoff_rate() / bench_position_count;
+
+            // sum up hash cutoffs of all search threads
+            for (int thread = 0; thread < search_threads; thread++)
+                hash_cuts += search_states[thread].hash_cutoffs;
+        }
+
+        // init single thread time
+        if (threads == 1)
+            single_thread_time = time;
+
+        // print results
+        printf("     %7d %12d %10.2f %14llu %10.1f%% %11llu\n", threads, time, (double)single_thread_time / (time ? time : 1), nodes, first_cut, hash_cuts);
+
+        // max threads reached
+        if (threads == max_threads)
+            break;
+    }
+
+    printf("\n");
+}
+
+/**********************************\
+ ==================================
+
+               Perft
+
+ ==================================
+\**********************************/
+
+// perft modes
+enum
+{
+    bulk_counting,
+    exhaustive
+};
+
+// current perft mode
+int perft_mode = bulk_counting;
+
+// take moves back by restoring a board copy instead of unmaking them
+int perft_copy_make = 0;
+
+/*
+    Perft hash table stores subtree node counts keyed on the position's
+    hash key and the remaining depth, so transpositions are counted once.
+    Worker threads share the table without locks: the key is stored XORed
+    with the data, so an entry torn by a concurrent write fails to verify.
+
+                    perft entry data bits
+
+    0000 0000 ... 0000 0000 1111 1111    depth         0xff
+    1111 1111 ... 1111 1111 0000 0000    nodes         data >> 8
+*/
+
+// perft hash table entry
+typedef struct
+{
+    // position hash key XOR data
+    U64 hash_key;
+
+    // subtree node count & remaining depth
+    U64 data;
+} perft_entry;
+
+// perft hash table (disabled when NULL)
+perft_entry *perft_table = NULL;
+
+// number of entries in perft hash table
+U64 perft_table_entries = 0;
+
+// allocate perft hash table of a given size in megabytes (0 disables it)
+void init_perft_table(int mb)
+{
+    // free previously allocated table
+    free(perft_table);
+    perft_table = NULL;
+    perft_table_entries = 0;
+
+    // perft hash table disabled
+    if (mb <= 0)
+        return;
+
+    // init number of entries
+    perft_table_entries = ((U64)mb * 0x100000) / sizeof(perft_entry);
+
+    // allocate zeroed memory for the table
+    perft_table = calloc(perft_table_entries, sizeof(perft_entry));
+
+    // allocation failed
+    if (perft_table == NULL)
+    {
+        printf("  Couldn't allocate %d MB for perft hash table!\n", mb);
+        perft_table_entries = 0;
+    }
+}
+
+// read subtree node count from perft hash table (0 if not found)
+static inline U64 read_perft_entry(U64 hash_key, int depth)
+{
+    // init hash table entry
+    perft_entry *entry = &perft_table[hash_key % perft_table_entries];
+
+    // read entry data once (other threads may be writing it)
+    U64 data = entry->data;
+
+    // make sure we're dealing with the exact position at the same depth
+    if ((entry->hash_key ^ data) == hash_key && (int)(data & 0xff) == depth)
+        // return subtree node count
+        return data >> 8;
+
+    // entry not found
+    return 0;
+}
+
+// write subtree node count to perft hash table (always replace)
+static inline void write_perft_entry(U64 hash_key, int depth, U64 subtree_nodes)
+{
+    // init hash table entry
+    perft_entry *entry = &perft_table[hash_key % perft_table_entries];
+
+    // init entry data
+    U64 data = (subtree_nodes << 8) | depth;
+
+    // store position & subtree node count
+    entry->hash_key = hash_key ^ data;
+    entry->data = data;
+}
+
+// perft driver (returns the number of leaf nodes at a given depth)
+static inline U64 perft_driver(position *pos, int depth)
+{
+    // reccursion escape condition
+    if (depth == 0)
+        // count reached position
+        return 1;
+
+    // leaf nodes (number of positions reached during the test of the move generator at a given depth)
+    U64 nodes = 0;
+
+    // subtree has been counted already (depth 1 is cheaper to count directly)
+    if (perft_table && depth > 1 && (nodes = read_perft_entry(pos->hash_key, depth)))
+        // return cached subtree nodes
+        return nodes;
+
+    // create move list instance
+    moves move_list[1];
+
+    // generate legal moves
+    generate_legal_moves(pos, move_list);
+
+#ifdef DEBUG
+    // make sure move validation accepts every generated move
+    for (int move_count = 0; move_count < move_list->count; move_count++)
+    {
+        // generated move was rejected
+        if (!is_pseudo_legal(pos, move_list->moves[move_count]) || !is_legal(pos, move_list->moves[move_count]))
+        {
+            printf("  Move validation rejects generated move ");
+            print_move(move_list->moves[move_count]);
+            printf("\n");
+            print_board(pos);
+            exit(1);
+        }
+    }
+#endif
+
+    // every legal move at depth 1 is a leaf node, no need to make it
+    if (depth == 1 && perft_mode == bulk_counting)
+        // count leaf nodes in bulk
+        return move_list->count;
+
+    // copy-make: preserve & restore whole board around every move
+    if (perft_copy_make)
+    {
+        // loop over generated moves
+        for (int move_count = 0; move_count < move_list->count; move_count++)
+        {
+            // preserve board state
+            copy_board(pos);
+
+            // make move
+            make_move(pos, move_list->moves[move_count], legal_moves);
+
+            // call perft driver recursively
+            nodes += perft_driver(pos, depth - 1);
+
+            // take back
+            take_back(pos);
+        }
+    }
+
+    // make-unmake: reverse every move from its undo record
+    else
+    {
+        // loop over generated moves
+        for (int move_count = 0; move_count < move_list->count; move_count++)
+        {
+            // make move
+            make_move(pos, move_list->moves[move_count], legal_moves);
+
+            // call perft driver recursively
+            nodes += perft_driver(pos, depth - 1);
+
+            // unmake move
+            unmake_move(pos, move_list->moves[move_count]);
+        }
+    }
+
+    // store subtree node count in perft hash table
+    if (perft_table && depth > 1)
+        write_perft_entry(pos->hash_key, depth, nodes);
+
+    // return leaf nodes
+    return nodes;
+}
+
+// perft test
+void perft_test(position *pos, int depth)
+{
+    printf("\n     Performance test (%s, %s)\n\n", (perft_mode == bulk_counting) ? "bulk counting" : "exhaustive",
+           perft_copy_make ? "copy-make" : "make-unmake");
+
+    // create move list instance
+    moves move_list[1];
+
+    // generate legal moves
+    generate_legal_moves(pos, move_list);
+
+    // init start time
+    long start = get_time_ms();
+
+    // leaf nodes
+    U64 nodes = 0;
+
+    // loop over generated moves
+    for (int move_count = 0; move_count < move_list->count; move_count++)
+    {
+        // preserve board state
+        copy_board(pos);
+
+        // make move
+        if (!make_move(pos, move_list->moves[move_count], legal_moves))
+            // skip to the next move
+            continue;
+
+        // call perft driver recursively
+        U64 move_nodes = perft_driver(pos, depth - 1);
+
+        // cummulative nodes
+        nodes += move_nodes;
+
+        // take back
+        take_back(pos);
+
+        // print move
+        printf("     move: %s%s%c  nodes: %llu\n", square_to_coordinates[get_move_source(move_list->moves[move_count])],
+               square_to_coordinates[get_move_target(move_list->moves[move_count])],
+               get_move_promotion(move_list->moves[move_count]) ? promoted_pieces[get_move_promoted(move_list->moves[move_count], white)] : ' ',
+               move_nodes);
+    }
+
+    // print results
+    printf("\n    Depth: %d\n", depth);
+    printf("    Nodes: %llu\n", nodes);
+    printf("     Time: %ld\n\n", get_time_ms() - start);
+}
+
+/**********************************\
+ ==================================
+
+           Threaded perft
+
+ ==================================
+\**********************************/
+
+/*
+    Threaded perft splits the tree at depth 2: every (root move, reply)
+    pair becomes a task. Idle workers claim the next pending task from a
+    shared atomic counter, copy the root position into their private
+    board and count the subtree. Task results are summed per root move
+    in move list order, so the divide output is the same no matter which
+    thread counted what.
+*/
+
+// perft task
+typedef struct
+{
+    // index of the root move in root move list
+    int root_index;
+
+    // reply to the root move
+    U16 move;
+
+    // subtree node count
+    U64 nodes;
+} perft_task;
+
+// root position shared with worker threads
+position *perft_root;
+
+// root move list
+moves perft_root_moves[1];
+
+// perft tasks
+perft_task *perft_tasks;
+
+// number of perft tasks
+int perft_task_count;
+
+// index of the next task to be claimed by an idle worker
+atomic_int next_perft_task;
+
+// depth of threaded perft
+int perft_depth;
+
+// most perft worker threads
+#define max_perft_threads 256
+
+// number of perft worker threads (main thread included)
+int perft_threads = 1;
+
+// perft worker thread
+void *perft_worker(void *arg)
+{
+    // workers share all of their state through globals
+    (void)arg;
+
+    // worker's private board (cache line aligned like the position structure requires)
+#ifdef WIN64
+    position *pos = _aligned_malloc(sizeof(position), 64);
+#else
+    position *pos = aligned_alloc(64, sizeof(position));
+#endif
+
+    // allocation failed, leave the tasks to other workers
+    if (pos == NULL)
+    {
+        printf("  Couldn't allocate perft worker's board!\n");
+        return NULL;
+    }
+
+    // loop until every task is claimed
+    while (1)
+    {
+        // claim next pending task
+        int task = atomic_fetch_add(&next_perft_task, 1);
+
+        // no tasks left
+        if (task >= perft_task_count)
+            break;
+
+        // set up private board
+        memcpy(pos, perft_root, sizeof(position));
+
+        // make root move & reply
+        make_move(pos, perft_root_moves->moves[perft_tasks[task].root_index], legal_moves);
+        make_move(pos, perft_tasks[task].move, legal_moves);
+
+        // count subtree nodes
+        perft_tasks[task].nodes = perft_driver(pos, perft_depth - 2);
+    }
+
+    // free private board
+#ifdef WIN64
+    _aligned_free(pos);
+#else
+    free(pos);
+#endif
+
+    return NULL;
+}
+
+// threaded perft test
+void perft_test_threaded(position *pos, int depth)
+{
+    // split at depth 2 isn't possible
+    if (depth < 2 || perft_threads < 2)
+    {
+        // fall back to single threaded perft
+        perft_test(pos, depth);
+        return;
+    }
+
+    printf("\n     Performance test (%s, %s, %d threads)\n\n", (perft_mode == bulk_counting) ? "bulk counting" : "exhaustive",
+           perft_copy_make ? "copy-make" : "make-unmake", perft_threads);
+
+    // init start time
+    long start = get_time_ms();
+
+    // init threaded perft state
+    perft_depth = depth;
+    perft_task_count = 0;
+    atomic_store(&next_perft_task, 0);
+    perft_root = pos;
+
+    // generate root moves
+    generate_legal_moves(pos, perft_root_moves);
+
+    // allocate tasks (no more than 256 replies to every root move)
+    perft_tasks = malloc(sizeof(perft_task) * 256 * (perft_root_moves->count + 1));
+
+    // make sure memory got allocated
+    if (perft_tasks == NULL)
+    {
+        printf("  Couldn't allocate perft tasks!\n");
+        return;
+    }
+
+    // loop over root moves
+    for (int root_index = 0; root_index < perft_root_moves->count; root_index++)
+    {
         // preserve board state
-        copy_board();
+        copy_board(pos);
+
+        // make root move
+        make_move(pos, perft_root_moves->moves[root_index], legal_moves);
+
+        // create move list instance
+        moves move_list[1];
+
+        // generate replies
+        generate_legal_moves(pos, move_list);
+
+        // loop over replies
+        for (int move_count = 0; move_count < move_list->count; move_count++)
+        {
+            // add new task
+            perft_tasks[perft_task_count].root_index = root_index;
+            perft_tasks[perft_task_count].move = move_list->moves[move_count];
+            perft_tasks[perft_task_count].nodes = 0;
+            perft_task_count++;
+        }
+
+        // take back
+        take_back(pos);
+    }
+
+    // helper worker threads
+    pthread_t threads[max_perft_threads];
+
+    // number of helpers started
+    int started = 0;
+
+    // start helpers, main thread is the last worker
+    for (int thread = 0; thread < perft_threads - 1; thread++)
+    {
+        // thread couldn't be created, the rest of the tasks is left to running workers & main thread
+        if (pthread_create(&threads[started], NULL, perft_worker, NULL))
+        {
+            printf("  Couldn't create perft worker thread %d!\n", thread);
+            break;
+        }
+
+        started++;
+    }
+
+    // main thread claims tasks along with the helpers
+    perft_worker(NULL);
+
+    // wait for helpers to finish
+    for (int thread = 0; thread < started; thread++)
+        pthread_join(threads[thread], NULL);
+
+    // every task has to be counted
+    if (atomic_load(&next_perft_task) < perft_task_count)
+    {
+        printf("  Perft tasks left uncounted!\n");
+        free(perft_tasks);
+        return;
+    }
+
+    // total leaf nodes
+    U64 total_nodes = 0;
+
+    // loop over root moves
+    for (int root_index = 0, task = 0; root_index < perft_root_moves->count; root_index++)
+    {
+        // root move leaf nodes
+        U64 move_nodes = 0;
+
+        // sum up results of the tasks belonging to current root move
+        while (task < perft_task_count && perft_tasks[task].root_index == root_index)
+            move_nodes += perft_tasks[task++].nodes;
+
+        // update total leaf nodes
+        total_nodes += move_nodes;
+
+        // init root move
+        int move = perft_root_moves->moves[root_index];
+
+        // print move
+        printf("     move: %s%s%c  nodes: %llu\n", square_to_coordinates[get_move_source(move)],
+               square_to_coordinates[get_move_target(move)],
+               get_move_promotion(move) ? promoted_pieces[get_move_promoted(move, white)] : ' ',
+               move_nodes);
+    }
+
+    // free tasks
+    free(perft_tasks);
+
+    // print results
+    printf("\n    Depth: %d\n", depth);
+    printf("    Nodes: %llu\n", total_nodes);
+    printf("     Time: %ld\n\n", get_time_ms() - start);
+}
+
+/**********************************\
+ ==================================
+
+           Baked tables
+
+ ==================================
+\**********************************/
+
+// print bitboard table as C array definition, rows of row_size entries get own braces
+void print_table(char *declaration, U64 *table, int size, int row_size)
+{
+    // print declaration
+    printf("%s = {", declaration);
+
+    // loop over table entries
+    for (int index = 0; index < size; index++)
+    {
+        // open new row
+        if (row_size && !(index % row_size))
+            printf("%s{", index ? ",\n    " : "\n    ");
+
+        // print entry, 4 entries per line
+        printf("%s0x%llxULL", (row_size && !(index % row_size)) ? "" :
+               index ? ((index % 4) ? ", " : ",\n    ") : "\n    ", table[index]);
+
+        // close row
+        if (row_size && !((index + 1) % row_size))
+            printf("}");
+    }
+
+    // close definition
+    printf("};\n\n");
+}
+
+// print integer table as C array definition, rows of row_size entries get own braces
+void print_int_table(char *declaration, int *table, int size, int row_size)
+{
+    // print declaration
+    printf("%s = {", declaration);
+
+    // loop over table entries
+    for (int index = 0; index < size; index++)
+    {
+        // open new row
+        if (row_size && !(index % row_size))
+            printf("%s{", index ? ",\n    " : "\n    ");
+
+        // print entry, 16 entries per line
+        printf("%s%d", (row_size && !(index % row_size)) ? "" :
+               index ? ((index % 16) ? ", " : ",\n    ") : "\n    ", table[index]);
+
+        // close row
+        if (row_size && !((index + 1) % row_size))
+            printf("}");
+    }
+
+    // close definition
+    printf("};\n\n");
+}
 
-        // make move
-        if (!make_move(move_list->moves[move_count], all_moves))
-            // skip to the next move
-            continue;
+// print attack tables as C source to be compiled in with -DBAKED_TABLES
+void print_tables()
+{
+    // print header comment
+    printf("// attack tables generated by bbc2 -printtables, do not edit\n");
+    printf("// sliders backend: %s\n\n", sliders_backend);
+
+    // print sliders backend tables were generated for
+#if defined(USE_PEXT)
+    printf("#define baked_pext 1\n#define baked_hyperbola 0\n\n");
+#elif defined(USE_HYPERBOLA)
+    printf("#define baked_pext 0\n#define baked_hyperbola 1\n\n");
+#else
+    printf("#define baked_pext 0\n#define baked_hyperbola 0\n\n");
+#endif
 
-        // call perft driver recursively
-        perft_driver(depth - 1);
+    // print magic numbers variant tables were generated for
+#ifdef SEARCHED_MAGICS
+    printf("#define baked_searched_magics 1\n\n");
+#else
+    printf("#define baked_searched_magics 0\n\n");
+#endif
 
-        // take back
-        take_back();
-    }
+    // print leaper pieces attacks
+    print_table("U64 pawn_attacks[2][64]", pawn_attacks[0], 128, 64);
+    print_table("U64 knight_attacks[64]", knight_attacks, 64, 0);
+    print_table("U64 king_attacks[64]", king_attacks, 64, 0);
+
+    // print slider pieces attack masks
+    print_table("U64 bishop_masks[64]", bishop_masks, 64, 0);
+    print_table("U64 rook_masks[64]", rook_masks, 64, 0);
+
+#ifdef USE_HYPERBOLA
+    // print hyperbola quintessence line masks
+    print_table("U64 diagonal_masks[64]", diagonal_masks, 64, 0);
+    print_table("U64 anti_diagonal_masks[64]", anti_diagonal_masks, 64, 0);
+    print_table("U64 file_masks[64]", file_masks, 64, 0);
+
+    // init rank attacks as integers
+    int rank_attacks[512];
+
+    // loop over rank attacks
+    for (int index = 0; index < 512; index++)
+        rank_attacks[index] = first_rank_attacks[index / 64][index % 64];
+
+    // print rank attacks
+    print_int_table("unsigned char first_rank_attacks[8][64]", rank_attacks, 512, 64);
+#else
+    // print slider pieces attacks
+    print_table("U64 slider_attacks[slider_table_size]", slider_attacks, slider_table_size, 0);
+    print_int_table("int bishop_offsets[64]", bishop_offsets, 64, 0);
+    print_int_table("int rook_offsets[64]", rook_offsets, 64, 0);
+    print_int_table("int bishop_shifts[64]", bishop_shifts, 64, 0);
+    print_int_table("int rook_shifts[64]", rook_shifts, 64, 0);
+#endif
+
+    // print between & line masks
+    print_table("U64 between_masks[64][64]", between_masks[0], 4096, 64);
+    print_table("U64 line_masks[64][64]", line_masks[0], 4096, 64);
 }
 
-// perft test
-void perft_test(int depth)
+/**********************************\
+ ==================================
+
+             Init all
+
+ ==================================
+\**********************************/
+
+// build attack tables at runtime
+void init_attack_tables()
+{
+    // init leaper pieces attacks
+    init_leapers_attacks();
+
+    // init slider pieces attacks
+#ifdef USE_HYPERBOLA
+    init_hyperbola_masks();
+#else
+    init_sliders_attacks(bishop);
+    init_sliders_attacks(rook);
+#endif
+
+    // init between & line masks
+    init_line_masks();
+}
+
+// init all variables
+void init_all()
+{
+    // make sure host CPU can run this build
+    check_cpu_features();
+
+// attack tables are compiled in
+#ifndef BAKED_TABLES
+    // init attack tables
+    init_attack_tables();
+#endif
+
+    // init random keys for hashing purposes
+    init_random_keys();
+}
+
+// number of startups timed by startup benchmark
+#define bench_startups 100
+
+// time engine process from exec to "uciok" (-1 if it couldn't be started)
+int time_engine_process(char *program)
+{
+    // init command (engine quits on end of input right after printing engine info)
+    char command[1024];
+#ifdef WIN64
+    snprintf(command, sizeof(command), "\"%s\" < NUL", program);
+#else
+    snprintf(command, sizeof(command), "\"%s\" < /dev/null", program);
+#endif
+
+    // init start time
+    int start = get_time_ms();
+
+    // start engine process
+    FILE *engine = popen(command, "r");
+
+    // process couldn't be started
+    if (engine == NULL)
+        return -1;
+
+    // engine output line
+    char line[256];
+
+    // wait for "uciok"
+    while (fgets(line, sizeof(line), engine))
+        if (!strncmp(line, "uciok", 5))
+            break;
+
+    // init elapsed time
+    int time = get_time_ms() - start;
+
+    // wait for the engine to quit
+    pclose(engine);
+
+    return time;
+}
+
+// time engine initialization (in process & as a whole new engine process)
+void bench_startup(char *program)
 {
-    printf("\n     Performance test\n\n");
+    // init start time
+    int start = get_time_ms();
+
+    // init engine over and over again
+    for (int count = 0; count < bench_startups; count++)
+        init_all();
+
+    // init init_all time
+    int init_time = get_time_ms() - start;
+
+    // reset start time
+    start = get_time_ms();
+
+    // build attack tables over and over again (baked builds only skip this part)
+    for (int count = 0; count < bench_startups; count++)
+        init_attack_tables();
 
+    // init tables building time
+    int tables_time = get_time_ms() - start;
+
+    // init engine processes time
+    int process_time = 0;
+
+    // start engine processes over and over again
+    for (int count = 0; count < bench_startups && process_time != -1; count++)
+    {
+        // time single engine process
+        int time = time_engine_process(program);
+
+        // sum up processes time
+        process_time = (time == -1) ? -1 : process_time + time;
+    }
+
+    // print benchmark results
+#ifdef BAKED_TABLES
+    printf("\n     Attack tables:   baked\n");
+#else
+    printf("\n     Attack tables:   built at startup\n");
+#endif
+    printf("     Startups:        %d\n", bench_startups);
+    printf("     init_all:        %.3f ms per startup\n", (double)init_time / bench_startups);
+    printf("     Building tables: %.3f ms per startup\n", (double)tables_time / bench_startups);
+
+    // print process startup time
+    if (process_time == -1)
+        printf("     Exec to uciok:   couldn't start %s\n\n", program);
+    else
+        printf("     Exec to uciok:   %.3f ms per startup\n\n", (double)process_time / bench_startups);
+}
+
+/**********************************\
+ ==================================
+
+                UCI
+
+ ==================================
+\**********************************/
+
+// parse user/GUI move string input (e.g. "e7e8q")
+int parse_move(position *pos, char *move_string)
+{
     // create move list instance
     moves move_list[1];
 
-    // generate moves
-    generate_moves(move_list);
+    // generate legal moves
+    generate_legal_moves(pos, move_list);
 
-    // init start time
-    long start = get_time_ms();
+    // parse source & target squares
+    int source_square = (move_string[0] - 'a') + (8 - (move_string[1] - '0')) * 8;
+    int target_square = (move_string[2] - 'a') + (8 - (move_string[3] - '0')) * 8;
 
-    // loop over generated moves
+    // loop over the moves within a move list
     for (int move_count = 0; move_count < move_list->count; move_count++)
     {
-        // preserve board state
-        copy_board();
+        // init move
+        int move = move_list->moves[move_count];
 
-        // make move
-        if (!make_move(move_list->moves[move_count], all_moves))
-            // skip to the next move
+        // make sure source & target squares are available within the generated move
+        if (source_square == get_move_source(move) && target_square == get_move_target(move))
+        {
+            // promotion piece has to match as well
+            if (get_move_promotion(move) && promoted_pieces[get_move_promoted(move, white)] != move_string[4])
+                continue;
+
+            // return legal move
+            return move;
+        }
+    }
+
+    // return illegal move
+    return 0;
+}
+
+// parse UCI "position" command (e.g. "position startpos moves e2e4 e7e5")
+void parse_position(position *pos, char *command)
+{
+    // shift pointer to the right where next token begins
+    command += 9;
+
+    // init pointer to the current character in the command string
+    char *current_char = command;
+
+    // parse UCI "startpos" command
+    if (strncmp(command, "startpos", 8) == 0)
+        parse_fen(pos, start_position);
+
+    // parse UCI "fen" command
+    else
+    {
+        // make sure "fen" command is available within command string
+        current_char = strstr(command, "fen");
+
+        // if no "fen" command is available within command string
+        if (current_char == NULL)
+            parse_fen(pos, start_position);
+
+        // found "fen" substring
+        else
+            parse_fen(pos, current_char + 4);
+    }
+
+    // parse moves after position
+    current_char = strstr(command, "moves");
+
+    // moves available
+    if (current_char != NULL)
+    {
+        // shift pointer to the right where next token begins
+        current_char += 6;
+
+        // loop over moves within a move string
+        while (*current_char)
+        {
+            // parse next move
+            int move = parse_move(pos, current_char);
+
+            // if no more moves
+            if (move == 0)
+                break;
+
+            // keep room for search plies in repetition table by dropping the oldest positions
+            if (pos->repetition_index >= 1000 - max_ply)
+            {
+                memmove(pos->repetition_table, pos->repetition_table + max_ply, (pos->repetition_index - max_ply) * sizeof(U64));
+                pos->repetition_index -= max_ply;
+            }
+
+            // remember position for repetition detection
+            pos->repetition_table[pos->repetition_index++] = pos->hash_key;
+
+            // make move on the chess board
+            make_move(pos, move, legal_moves);
+
+            // game moves are never taken back, keep the whole undo stack for the search
+            pos->undo_index = 0;
+
+            // move current character pointer to the end of current move
+            while (*current_char && *current_char != ' ')
+                current_char++;
+
+            // go to the next move
+            if (*current_char)
+                current_char++;
+        }
+    }
+}
+
+// time kept in reserve for GUI communication lag (ms)
+#define move_overhead 50
+
+// parse UCI "go" command (e.g. "go wtime 60000 btime 60000 winc 1000 binc 1000")
+void parse_go(position *pos, char *command)
+{
+    // reset time control
+    movestogo = 30;
+    movetime = -1;
+    uci_time = -1;
+    inc = 0;
+    timeset = 0;
+
+    // init search depth (as deep as possible by default)
+    int depth = max_ply;
+
+    // init argument
+    char *argument = NULL;
+
+    // match UCI "binc" command
+    if ((argument = strstr(command, "binc")) && pos->side == black)
+        inc = atoi(argument + 5);
+
+    // match UCI "winc" command
+    if ((argument = strstr(command, "winc")) && pos->side == white)
+        inc = atoi(argument + 5);
+
+    // match UCI "wtime" command
+    if ((argument = strstr(command, "wtime")) && pos->side == white)
+        uci_time = atoi(argument + 6);
+
+    // match UCI "btime" command
+    if ((argument = strstr(command, "btime")) && pos->side == black)
+        uci_time = atoi(argument + 6);
+
+    // match UCI "movestogo" command
+    if ((argument = strstr(command, "movestogo")))
+        movestogo = atoi(argument + 10);
+
+    // match UCI "movetime" command
+    if ((argument = strstr(command, "movetime")))
+        movetime = atoi(argument + 9);
+
+    // match UCI "depth" command
+    if ((argument = strstr(command, "depth")))
+        depth = atoi(argument + 6);
+
+    // init start time
+    starttime = get_time_ms();
+
+    // fixed time per move
+    if (movetime != -1)
+    {
+        // flag we're playing with time control
+        timeset = 1;
+        stoptime = starttime + movetime - move_overhead;
+    }
+
+    // clock is running
+    else if (uci_time != -1)
+    {
+        // flag we're playing with time control
+        timeset = 1;
+
+        // spread the time left over the moves to go, never going beyond the clock
+        int time = uci_time / (movestogo > 0 ? movestogo : 1) + inc;
+
+        if (time > uci_time - move_overhead)
+            time = uci_time - move_overhead;
+
+        stoptime = starttime + time - move_overhead;
+    }
+
+    // search position
+    search_position(pos, depth);
+}
+
+// maximum transposition table size in megabytes
+#define max_hash_mb 65536
+
+// print engine info & options
+void print_engine_info()
+{
+    printf("id name BBC\n");
+    printf("id author Code Monkey King\n");
+    printf("option name Hash type spin default %d min 1 max %d\n", default_hash_mb, max_hash_mb);
+    printf("option name Threads type spin default 1 min 1 max %d\n", max_search_threads);
+    printf("uciok\n");
+}
+
+// parse UCI "setoption" command (e.g. "setoption name Hash value 128")
+void parse_setoption(char *command)
+{
+    // init argument
+    char *argument = NULL;
+
+    // match "Hash" option
+    if (strstr(command, "name Hash") && (argument = strstr(command, "value")))
+    {
+        // init requested size
+        int mb = atoi(argument + 6);
+
+        // keep size within bounds
+        if (mb < 1) mb = 1;
+        if (mb > max_hash_mb) mb = max_hash_mb;
+
+        // reallocate transposition table
+        init_hash_table(mb);
+    }
+
+    // match "Threads" option
+    else if (strstr(command, "name Threads") && (argument = strstr(command, "value")))
+    {
+        // init requested number of threads
+        int threads = atoi(argument + 6);
+
+        // keep number of threads within bounds
+        if (threads < 1) threads = 1;
+        if (threads > max_search_threads) threads = max_search_threads;
+
+        // reallocate search states
+        init_search_threads(threads);
+    }
+}
+
+// main UCI loop
+void uci_loop(position *pos)
+{
+    // reset STDIN & STDOUT buffers
+    setbuf(stdin, NULL);
+    setbuf(stdout, NULL);
+
+    // define user / GUI input buffer
+    char input[10000];
+
+    // init engine on the start position
+    parse_fen(pos, start_position);
+
+    // allocate transposition table & single search thread state
+    init_hash_table(default_hash_mb);
+    init_search_threads(1);
+
+    // print engine info
+    print_engine_info();
+
+    // main loop
+    while (!quit)
+    {
+        // reset user /GUI input
+        memset(input, 0, sizeof(input));
+
+        // get user / GUI input (quit on end of input)
+        if (!fgets(input, sizeof(input), stdin))
+            break;
+
+        // make sure input is available
+        if (input[0] == '\n')
             continue;
 
-        // cummulative nodes
-        long cummulative_nodes = nodes;
+        // parse UCI "isready" command
+        if (strncmp(input, "isready", 7) == 0)
+            printf("readyok\n");
 
-        // call perft driver recursively
-        perft_driver(depth - 1);
+        // parse UCI "position" command
+        else if (strncmp(input, "position", 8) == 0)
+            parse_position(pos, input);
 
-        // old nodes
-        long old_nodes = nodes - cummulative_nodes;
+        // parse UCI "ucinewgame" command
+        else if (strncmp(input, "ucinewgame", 10) == 0)
+        {
+            // results of the previous game are of no use
+            parse_position(pos, "position startpos");
+            clear_hash_table();
+            init_search_threads(search_threads);
+        }
 
-        // take back
-        take_back();
+        // parse UCI "go" command
+        else if (strncmp(input, "go", 2) == 0)
+            parse_go(pos, input);
 
-        // print move
-        printf("     move: %s%s%c  nodes: %ld\n", square_to_coordinates[get_move_source(move_list->moves[move_count])],
-               square_to_coordinates[get_move_target(move_list->moves[move_count])],
-               get_move_promoted(move_list->moves[move_count]) ? promoted_pieces[get_move_promoted(move_list->moves[move_count])] : ' ',
-               old_nodes);
+        // parse UCI "quit" command
+        else if (strncmp(input, "quit", 4) == 0)
+            break;
+
+        // parse UCI "setoption" command
+        else if (strncmp(input, "setoption", 9) == 0)
+            parse_setoption(input);
+
+        // parse UCI "uci" command
+        else if (strncmp(input, "uci", 3) == 0)
+        {
+            // print engine info
+            print_engine_info();
+        }
     }
+}
 
-    // print results
-    printf("\n    Depth: %d\n", depth);
-    printf("    Nodes: %lld\n", nodes);
-    printf("     Time: %ld\n\n", get_time_ms() - start);
+/**********************************\
+ ==================================
+
+             Main driver
+
+ ==================================
+\**********************************/
+
+// print command line usage
+void print_usage(char *program)
+{
+    printf("\n  Usage: %s [options]\n\n", program);
+    printf("    -fen \"<fen>\"    position to run perft on (tricky position by default)\n");
+    printf("    -depth <n>      perft depth, at least 1 (5 by default)\n");
+    printf("    -bulk           count legal moves at depth 1 without making them (default)\n");
+    printf("    -exhaustive     make and take back every leaf move\n");
+    printf("    -copymake       take moves back by restoring a board copy instead of unmake_move\n");
+    printf("    -hash <mb>      perft hash table size in megabytes (0 = disabled by default)\n");
+    printf("    -threads <n>    number of perft worker threads or most search threads benchmarked (1-256, 1 by default)\n");
+    printf("    -benchsliders   time slider attacks lookups of the compiled backend & exit\n");
+    printf("    -benchstartup   time engine initialization in process & from exec to uciok & exit\n");
+    printf("    -benchsmp       time Lazy SMP search to -depth with 1, 2, 4 ... -threads threads & exit\n");
+    printf("    -printtables    print attack tables as C source for -DBAKED_TABLES builds & exit\n\n");
+    printf("  Without options the engine talks UCI on standard input & output.\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+    // init all
+    init_all();
+
+    // init position
+    position pos[1];
+
+    // no options: play chess over UCI protocol
+    if (argc == 1)
+    {
+        // connect to the GUI
+        uci_loop(pos);
+        return 0;
+    }
+
+    // init default perft position & depth
+    char *fen = tricky_position;
+    int depth = 5;
+
+    // Lazy SMP benchmark flag
+    int smp_benchmark = 0;
+
+    // parse command line arguments
+    for (int arg = 1; arg < argc; arg++)
+    {
+        // match perft position
+        if (!strcmp(argv[arg], "-fen") && arg + 1 < argc)
+            fen = argv[++arg];
+
+        // match perft depth
+        else if (!strcmp(argv[arg], "-depth") && arg + 1 < argc)
+            depth = atoi(argv[++arg]);
+
+        // match bulk counting perft
+        else if (!strcmp(argv[arg], "-bulk"))
+            perft_mode = bulk_counting;
+
+        // match exhaustive perft
+        else if (!strcmp(argv[arg], "-exhaustive"))
+            perft_mode = exhaustive;
+
+        // match copy-make perft
+        else if (!strcmp(argv[arg], "-copymake"))
+            perft_copy_make = 1;
+
+        // match perft hash table size
+        else if (!strcmp(argv[arg], "-hash") && arg + 1 < argc)
+            init_perft_table(atoi(argv[++arg]));
+
+        // match number of perft worker threads
+        else if (!strcmp(argv[arg], "-threads") && arg + 1 < argc)
+        {
+            // init number of threads
+            perft_threads = atoi(argv[++arg]);
+
+            // keep threads number within range
+            if (perft_threads < 1) perft_threads = 1;
+            if (perft_threads > max_perft_threads) perft_threads = max_perft_threads;
+        }
+
+        // match sliders benchmark
+        else if (!strcmp(argv[arg], "-benchsliders"))
+        {
+            bench_sliders();
+            return 0;
+        }
+
+        // match startup benchmark
+        else if (!strcmp(argv[arg], "-benchstartup"))
+        {
+            bench_startup(argv[0]);
+            return 0;
+        }
+
+        // match Lazy SMP benchmark (run once depth & threads are known)
+        else if (!strcmp(argv[arg], "-benchsmp"))
+            smp_benchmark = 1;
+
+        // match attack tables printing
+        else if (!strcmp(argv[arg], "-printtables"))
+        {
+            print_tables();
+            return 0;
+        }
+
+        // unknown argument
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // perft & search need at least one ply
+    if (depth < 1)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // run Lazy SMP benchmark
+    if (smp_benchmark)
+    {
+        bench_smp(depth, perft_threads);
+        return 0;
+    }
+
+    // parse fen
+    parse_fen(pos, fen);
+    print_board(pos);
+
+    // run perft
+    perft_test_threaded(pos, depth);
+
+    return 0;
 }
@@ -0,0 +1,587 @@
+/**********************************\
+ ==================================
+
+        Magic numbers search
+      for BBC bitboard engine
+
+ ==================================
+\**********************************/
+
+/*
+    Offline multithreaded search for dense slider magics.
+
+    Plain magics map every relevant occupancy of a square to its own
+    2^(relevant bits) attacks table slot. Occupancies sharing the same
+    attacks may however share the slot too (constructive collisions),
+    so a magic number may fit into fewer index bits. This tool looks
+    for such shift-reduced magics square by square, starting from the
+    standard index size and dropping one index bit at a time as long
+    as a magic number is found within the attempts budget & time limit.
+    The last index size tried always uses up the whole budget, so the
+    budget is kept small. Savings are modest: with the defaults only a
+    handful of bishop squares (and rarely a rook square) drop a bit.
+
+    Every square is searched with its own seed, so the result is the
+    same for a given seed & budget no matter how many threads are used,
+    unless the time limit cuts the search short.
+
+    Usage: magic_search [-threads <n>] [-attempts <n>] [-seconds <n>] [-seed <n>] > magics.h
+
+    Resulting header is picked up by bbc2.c built with -DSEARCHED_MAGICS.
+*/
+
+// system headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+// define bitboard data type
+#define U64 unsigned long long
+
+// sliding pieces
+enum
+{
+    rook,
+    bishop
+};
+
+/**********************************\
+ ==================================
+
+          Bit manipulations
+
+ ==================================
+\**********************************/
+
+// count bits within a bitboard
+static inline int count_bits(U64 bitboard)
+{
+    // hardware or compiler provided population count
+    return __builtin_popcountll(bitboard);
+}
+
+// get least significant 1st bit index
+static inline int get_ls1b_index(U64 bitboard)
+{
+    // count trailing zeros
+    return bitboard ? __builtin_ctzll(bitboard) : -1;
+}
+
+// set occupancies
+U64 set_occupancy(int index, int bits_in_mask, U64 attack_mask)
+{
+    // occupancy map
+    U64 occupancy = 0ULL;
+
+    // loop over the range of bits within attack mask
+    for (int count = 0; count < bits_in_mask; count++)
+    {
+        // get LS1B index of attacks mask
+        int square = get_ls1b_index(attack_mask);
+
+        // pop LS1B in attack map
+        attack_mask &= attack_mask - 1;
+
+        // make sure occupancy is on board
+        if (index & (1 << count))
+            // populate occupancy map
+            occupancy |= (1ULL << square);
+    }
+
+    // return occupancy map
+    return occupancy;
+}
+
+/**********************************\
+ ==================================
+
+              Attacks
+
+ ==================================
+\**********************************/
+
+// mask bishop attacks
+U64 mask_bishop_attacks(int square)
+{
+    // result attacks bitboard
+    U64 attacks = 0ULL;
+
+    // init ranks & files
+    int r, f;
+
+    // init target rank & files
+    int tr = square / 8;
+    int tf = square % 8;
+
+    // mask relevant bishop occupancy bits
+    for (r = tr + 1, f = tf + 1; r <= 6 && f <= 6; r++, f++)
+        attacks |= (1ULL << (r * 8 + f));
+    for (r = tr - 1, f = tf + 1; r >= 1 && f <= 6; r--, f++)
+        attacks |= (1ULL << (r * 8 + f));
+    for (r = tr + 1, f = tf - 1; r <= 6 && f >= 1; r++, f--)
+        attacks |= (1ULL << (r * 8 + f));
+    for (r = tr - 1, f = tf - 1; r >= 1 && f >= 1; r--, f--)
+        attacks |= (1ULL << (r * 8 + f));
+
+    // return attack map
+    return attacks;
+}
+
+// mask rook attacks
+U64 mask_rook_attacks(int square)
+{
+    // result attacks bitboard
+    U64 attacks = 0ULL;
+
+    // init ranks & files
+    int r, f;
+
+    // init target rank & files
+    int tr = square / 8;
+    int tf = square % 8;
+
+    // mask relevant rook occupancy bits
+    for (r = tr + 1; r <= 6; r++)
+        attacks |= (1ULL << (r * 8 + tf));
+    for (r = tr - 1; r >= 1; r--)
+        attacks |= (1ULL << (r * 8 + tf));
+    for (f = tf + 1; f <= 6; f++)
+        attacks |= (1ULL << (tr * 8 + f));
+    for (f = tf - 1; f >= 1; f--)
+        attacks |= (1ULL << (tr * 8 + f));
+
+    // return attack map
+    return attacks;
+}
+
+// generate bishop attacks on the fly
+U64 bishop_attacks_on_the_fly(int square, U64 block)
+{
+    // result attacks bitboard
+    U64 attacks = 0ULL;
+
+    // init ranks & files
+    int r, f;
+
+    // init target rank & files
+    int tr = square / 8;
+    int tf = square % 8;
+
+    // generate bishop atacks
+    for (r = tr + 1, f = tf + 1; r <= 7 && f <= 7; r++, f++)
+    {
+        attacks |= (1ULL << (r * 8 + f));
+        if ((1ULL << (r * 8 + f)) & block)
+            break;
+    }
+
+    for (r = tr - 1, f = tf + 1; r >= 0 && f <= 7; r--, f++)
+    {
+        attacks |= (1ULL << (r * 8 + f));
+        if ((1ULL << (r * 8 + f)) & block)
+            break;
+    }
+
+    for (r = tr + 1, f = tf - 1; r <= 7 && f >= 0; r++, f--)
+    {
+        attacks |= (1ULL << (r * 8 + f));
+        if ((1ULL << (r * 8 + f)) & block)
+            break;
+    }
+
+    for (r = tr - 1, f = tf - 1; r >= 0 && f >= 0; r--, f--)
+    {
+        attacks |= (1ULL << (r * 8 + f));
+        if ((1ULL << (r * 8 + f)) & block)
+            break;
+    }
+
+    // return attack map
+    return attacks;
+}
+
+// generate rook attacks on the fly
+U64 rook_attacks_on_the_fly(int square, U64 block)
+{
+    // result attacks bitboard
+    U64 attacks = 0ULL;
+
+    // init ranks & files
+    int r, f;
+
+    // init target rank & files
+    int tr = square / 8;
+    int tf = square % 8;
+
+    // generate rook attacks
+    for (r = tr + 1; r <= 7; r++)
+    {
+        attacks |= (1ULL << (r * 8 + tf));
+        if ((1ULL << (r * 8 + tf)) & block)
+            break;
+    }
+
+    for (r = tr - 1; r >= 0; r--)
+    {
+        attacks |= (1ULL << (r * 8 + tf));
+        if ((1ULL << (r * 8 + tf)) & block)
+            break;
+    }
+
+    for (f = tf + 1; f <= 7; f++)
+    {
+        attacks |= (1ULL << (tr * 8 + f));
+        if ((1ULL << (tr * 8 + f)) & block)
+            break;
+    }
+
+    for (f = tf - 1; f >= 0; f--)
+    {
+        attacks |= (1ULL << (tr * 8 + f));
+        if ((1ULL << (tr * 8 + f)) & block)
+            break;
+    }
+
+    // return attack map
+    return attacks;
+}
+
+/**********************************\
+ ==================================
+
+               Search
+
+ ==================================
+\**********************************/
+
+// search settings
+int search_threads = 4;
+long long search_attempts = 1000000;
+int search_seconds = 60;
+U64 search_seed = 1804289383ULL;
+
+// time shift reduction has to be done by (seconds)
+double search_deadline;
+
+// search results [piece][square]
+U64 found_magics[2][64];
+int found_bits[2][64];
+
+// next square to search (rook squares 0..63, bishop squares 64..127)
+atomic_int next_search_task;
+
+// get monotonic time in seconds
+static inline double get_time()
+{
+    // init time
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    // return time in seconds
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// generate 64-bit pseudo random numbers (XOR shift * algorithm)
+static inline U64 get_random_number(U64 *state)
+{
+    // XOR shift algorithm
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    // scramble the state non-linearly
+    return *state * 2685821657736338717ULL;
+}
+
+// try to find magic number mapping square's occupancies into a given number of index bits
+U64 find_magic_number(U64 attack_mask, int relevant_bits, int index_bits, U64 *occupancies, U64 *attacks, U64 *state)
+{
+    // used attacks & search attempt they were set at
+    static _Thread_local U64 used_attacks[4096];
+    static _Thread_local long long used_attempt[4096];
+
+    // reset used attacks
+    memset(used_attempt, -1, sizeof(used_attempt));
+
+    // init occupancy indicies
+    int occupancy_indicies = 1 << relevant_bits;
+
+    // test magic numbers loop
+    // (standard index size always has a magic number, so it's searched until one is found)
+    for (long long attempt = 0; attempt < search_attempts || index_bits == relevant_bits; attempt++)
+    {
+        // shift reduction gives up once out of time
+        if (index_bits < relevant_bits && !(attempt & 0xffff) && get_time() > search_deadline)
+            break;
+
+        // generate magic number candidate (sparse ones suit standard index sizes,
+        // dense ones are more likely to collide constructively into fewer bits)
+        U64 magic_number = get_random_number(state);
+
+        // make every other candidate sparse (all of them for standard index size)
+        if ((attempt & 1) || index_bits == relevant_bits)
+        {
+            // sparse magic number candidate
+            magic_number &= get_random_number(state) & get_random_number(state);
+
+            // skip inappropriate magic numbers
+            if (count_bits((attack_mask * magic_number) & 0xFF00000000000000ULL) < 6)
+                continue;
+        }
+
+        // init index & fail flag
+        int index, fail;
+
+        // test magic index loop
+        for (index = 0, fail = 0; !fail && index < occupancy_indicies; index++)
+        {
+            // init magic index
+            int magic_index = (int)((occupancies[index] * magic_number) >> (64 - index_bits));
+
+            // slot is still free in this attempt
+            if (used_attempt[magic_index] != attempt)
+            {
+                // occupy the slot
+                used_attempt[magic_index] = attempt;
+                used_attacks[magic_index] = attacks[index];
+            }
+
+            // slot is taken by different attacks (destructive collision)
+            else if (used_attacks[magic_index] != attacks[index])
+                // magic index doesn't work
+                fail = 1;
+        }
+
+        // if magic number works
+        if (!fail)
+            // return it
+            return magic_number;
+    }
+
+    // no magic number found within the budget
+    return 0ULL;
+}
+
+// search the densest magic number for a given square
+void search_square(int square, int piece)
+{
+    // init occupancies & attacks
+    static _Thread_local U64 occupancies[4096];
+    static _Thread_local U64 attacks[4096];
+
+    // init attack mask for a current piece
+    U64 attack_mask = (piece == bishop) ? mask_bishop_attacks(square) : mask_rook_attacks(square);
+
+    // init relevant occupancy bit count
+    int relevant_bits = count_bits(attack_mask);
+
+    // loop over occupancy indicies
+    for (int index = 0; index < (1 << relevant_bits); index++)
+    {
+        // init occupancies
+        occupancies[index] = set_occupancy(index, relevant_bits, attack_mask);
+
+        // init attacks
+        attacks[index] = (piece == bishop) ? bishop_attacks_on_the_fly(square, occupancies[index]) :
+                                             rook_attacks_on_the_fly(square, occupancies[index]);
+    }
+
+    // init square's own random state
+    U64 state = search_seed ^ ((U64)(piece * 64 + square + 1) * 0x9E3779B97F4A7C15ULL);
+
+    // reset result
+    found_magics[piece][square] = 0ULL;
+    found_bits[piece][square] = relevant_bits;
+
+    // drop index bits one by one while magic numbers are found
+    for (int index_bits = relevant_bits; index_bits > 0; index_bits--)
+    {
+        // search magic number
+        U64 magic_number = find_magic_number(attack_mask, relevant_bits, index_bits, occupancies, attacks, &state);
+
+        // no magic number fits into current index bits
+        if (!magic_number)
+            break;
+
+        // store the densest magic so far
+        found_magics[piece][square] = magic_number;
+        found_bits[piece][square] = index_bits;
+    }
+
+    // print progress
+    fprintf(stderr, "  %s square %2d: %2d -> %2d bits%s\n", (piece == bishop) ? "bishop" : "rook  ",
+            square, relevant_bits, found_bits[piece][square], found_magics[piece][square] ? "" : " (not found!)");
+}
+
+// search worker thread
+void *search_worker(void *arg)
+{
+    // workers share all of their state through globals
+    (void)arg;
+
+    // loop over squares left to search
+    for (int task = atomic_fetch_add(&next_search_task, 1); task < 128; task = atomic_fetch_add(&next_search_task, 1))
+        // rook squares first, slowest ones get picked up early
+        search_square(task % 64, (task < 64) ? rook : bishop);
+
+    return NULL;
+}
+
+/**********************************\
+ ==================================
+
+               Output
+
+ ==================================
+\**********************************/
+
+// print search results as C header
+void print_magics()
+{
+    // init table offsets
+    int offset = 0;
+
+    // print header comment
+    printf("// slider magics generated by magic_search -attempts %lld -seconds %d -seed %llu, do not edit\n\n",
+           search_attempts, search_seconds, search_seed);
+
+    // loop over pieces (bishop attacks go first in the shared table)
+    for (int piece = bishop; piece >= rook; piece--)
+    {
+        // piece name
+        char *name = (piece == bishop) ? "bishop" : "rook";
+
+        // print magic numbers
+        printf("// %s magic numbers\nU64 %s_magic_numbers[64] = {", name, name);
+        for (int square = 0; square < 64; square++)
+            printf("%s0x%llxULL", square ? ((square % 4) ? ", " : ",\n    ") : "\n    ", found_magics[piece][square]);
+        printf("};\n\n");
+
+        // print index bits
+        printf("// %s magic index bits\nconst int %s_index_bits[64] = {", name, name);
+        for (int square = 0; square < 64; square++)
+            printf("%s%d", square ? ((square % 8) ? ", " : ",\n    ") : "\n    ", found_bits[piece][square]);
+        printf("};\n\n");
+
+        // print table offsets
+        printf("// %s attacks offsets within shared slider attacks table\nconst int %s_table_offsets[64] = {", name, name);
+        for (int square = 0; square < 64; square++)
+        {
+            printf("%s%d", square ? ((square % 8) ? ", " : ",\n    ") : "\n    ", offset);
+            offset += 1 << found_bits[piece][square];
+        }
+        printf("};\n\n");
+
+        // print number of bishop entries once bishop squares are done
+        if (piece == bishop)
+            printf("// number of bishop attacks entries\n#define bishop_table_size %d\n\n", offset);
+    }
+
+    // print total table size
+    printf("// number of bishop & rook attacks entries\n#define slider_table_size %d\n", offset);
+
+    // print total table size to console as well
+    fprintf(stderr, "\n  Slider attacks table: %d entries (%d KB)\n", offset, offset * 8 / 1024);
+}
+
+/**********************************\
+ ==================================
+
+             Main driver
+
+ ==================================
+\**********************************/
+
+int main(int argc, char *argv[])
+{
+    // parse command line arguments
+    for (int arg = 1; arg < argc; arg++)
+    {
+        // match number of search threads
+        if (!strcmp(argv[arg], "-threads") && arg + 1 < argc)
+            search_threads = atoi(argv[++arg]);
+
+        // match attempts budget per index size
+        else if (!strcmp(argv[arg], "-attempts") && arg + 1 < argc)
+            search_attempts = atoll(argv[++arg]);
+
+        // match shift reduction time limit
+        else if (!strcmp(argv[arg], "-seconds") && arg + 1 < argc)
+            search_seconds = atoi(argv[++arg]);
+
+        // match random seed
+        else if (!strcmp(argv[arg], "-seed") && arg + 1 < argc)
+            search_seed = strtoull(argv[++arg], NULL, 10);
+
+        // unknown argument
+        else
+        {
+            fprintf(stderr, "\n  Usage: %s [-threads <n>] [-attempts <n>] [-seconds <n>] [-seed <n>] > magics.h\n\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // at least one search thread
+    if (search_threads < 1)
+        search_threads = 1;
+
+    // search thread handles
+    pthread_t *threads = malloc(search_threads * sizeof(pthread_t));
+
+    // make sure memory got allocated
+    if (threads == NULL)
+    {
+        fprintf(stderr, "\n  Couldn't allocate %d search threads!\n\n", search_threads);
+        return 1;
+    }
+
+    // shift reduction stops once time is up
+    search_deadline = get_time() + search_seconds;
+
+    // start searching from the first square
+    atomic_store(&next_search_task, 0);
+
+    // number of search threads actually started
+    int started = 0;
+
+    // start helper threads, main thread is the last search thread
+    for (int thread = 0; thread < search_threads - 1; thread++)
+    {
+        // stop spawning on failure, the main thread picks up what's left
+        if (pthread_create(&threads[started], NULL, search_worker, NULL))
+        {
+            fprintf(stderr, "  Couldn't create search thread %d!\n", thread);
+            break;
+        }
+
+        started++;
+    }
+
+    // main thread searches whatever squares are left
+    search_worker(NULL);
+
+    // wait for search threads to finish
+    for (int thread = 0; thread < started; thread++)
+        pthread_join(threads[thread], NULL);
+
+    // free thread handles
+    free(threads);
+
+    // make sure every square got a magic number
+    for (int square = 0; square < 128; square++)
+    {
+        if (!found_magics[square / 64][square % 64])
+        {
+            fprintf(stderr, "\n  Magic number search failed!\n\n");
+            return 1;
+        }
+    }
+
+    // print header
+    print_magics();
+
+    return 0;
+}